@@ -0,0 +1,376 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/tasklet.h"
+#include "openthread/ip6.h"
+#include "openthread/mqttsn.h"
+#include "openthread/dataset.h"
+#include "openthread/link.h"
+#include "openthread/platform/alarm-milli.h"
+#include "openthread-system.h"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// Period of publishing measured values
+#define PUBLISH_INTERVAL_MS 10000
+// Retransmission timeout bounds in seconds, client timeout granularity is one second
+#define RETRANSMISSION_TIMEOUT_MIN 1
+#define RETRANSMISSION_TIMEOUT_MAX 30
+#define RETRANSMISSION_TIMEOUT_INITIAL 3
+#define RETRANSMISSION_COUNT 3
+// Clock granularity used in timeout computation in ms
+#define CLOCK_GRANULARITY_MS 10
+// Configured timeout is lowered only when it exceeds the estimate by more than this,
+// so estimate moving around whole second boundary does not cause reconnects
+#define RETRANSMISSION_TIMEOUT_HYSTERESIS_MS 1000
+
+// Smoothed round-trip time estimator as specified in RFC 6298
+typedef struct RttEstimator
+{
+    bool mHasSample;
+    uint32_t mSrtt;
+    uint32_t mRttVar;
+    uint32_t mTimeout;
+} RttEstimator;
+
+// Timestamp of one transaction waiting for acknowledgement
+typedef struct Transaction
+{
+    bool mIsPending;
+    uint32_t mSentAt;
+} Transaction;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static RttEstimator sRtt;
+static Transaction sConnectTransaction;
+static Transaction sRegisterTransaction;
+static Transaction sPublishTransaction;
+static otMqttsnTopic sTopic;
+static bool sTopicRegistered = false;
+static uint32_t sNextPublishAt = 0;
+// Retransmission timeout in ms which was used in last connect configuration
+static uint32_t sConfiguredTimeout = RETRANSMISSION_TIMEOUT_INITIAL * 1000;
+// Client disconnected to apply new retransmission timeout and connects again
+static bool sReapplyTimeout = false;
+
+static uint32_t GetRetransmissionTimeout(void)
+{
+    // Current retransmission timeout in ms
+    return sRtt.mTimeout;
+}
+
+static uint32_t GetConfigurableTimeout(void)
+{
+    // Client takes timeout in whole seconds, estimate is rounded up
+    return (GetRetransmissionTimeout() + 999) / 1000 * 1000;
+}
+
+static bool IsTimeoutDrifted(void)
+{
+    uint32_t timeout = GetConfigurableTimeout();
+    return timeout > sConfiguredTimeout || timeout + RETRANSMISSION_TIMEOUT_HYSTERESIS_MS < sConfiguredTimeout;
+}
+
+static void RttInit(void)
+{
+    sRtt.mHasSample = false;
+    sRtt.mSrtt = 0;
+    sRtt.mRttVar = 0;
+    sRtt.mTimeout = RETRANSMISSION_TIMEOUT_INITIAL * 1000;
+}
+
+static void RttUpdateTimeout(uint32_t aTimeout)
+{
+    if (aTimeout < RETRANSMISSION_TIMEOUT_MIN * 1000)
+    {
+        aTimeout = RETRANSMISSION_TIMEOUT_MIN * 1000;
+    }
+    if (aTimeout > RETRANSMISSION_TIMEOUT_MAX * 1000)
+    {
+        aTimeout = RETRANSMISSION_TIMEOUT_MAX * 1000;
+    }
+    sRtt.mTimeout = aTimeout;
+}
+
+static void RttAddSample(uint32_t aRtt)
+{
+    if (!sRtt.mHasSample)
+    {
+        sRtt.mSrtt = aRtt;
+        sRtt.mRttVar = aRtt / 2;
+        sRtt.mHasSample = true;
+    }
+    else
+    {
+        uint32_t delta = sRtt.mSrtt > aRtt ? sRtt.mSrtt - aRtt : aRtt - sRtt.mSrtt;
+        // RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|, SRTT = 7/8 * SRTT + 1/8 * R
+        sRtt.mRttVar = sRtt.mRttVar - (sRtt.mRttVar >> 2) + (delta >> 2);
+        sRtt.mSrtt = sRtt.mSrtt - (sRtt.mSrtt >> 3) + (aRtt >> 3);
+    }
+    RttUpdateTimeout(sRtt.mSrtt + (4 * sRtt.mRttVar > CLOCK_GRANULARITY_MS ? 4 * sRtt.mRttVar : CLOCK_GRANULARITY_MS));
+}
+
+static void TransactionStart(Transaction *aTransaction)
+{
+    aTransaction->mIsPending = true;
+    aTransaction->mSentAt = otPlatAlarmMilliGetNow();
+}
+
+static void TransactionFinish(Transaction *aTransaction, otMqttsnReturnCode aCode)
+{
+    uint32_t rtt = otPlatAlarmMilliGetNow() - aTransaction->mSentAt;
+    uint32_t timeout = GetRetransmissionTimeout();
+
+    if (!aTransaction->mIsPending)
+    {
+        return;
+    }
+    aTransaction->mIsPending = false;
+    if (aCode == kCodeTimeout)
+    {
+        // All retransmissions timed out, back off
+        RttUpdateTimeout(2 * GetRetransmissionTimeout());
+    }
+    else if (rtt < (timeout < sConfiguredTimeout ? timeout : sConfiguredTimeout))
+    {
+        // Karn's rule: response which came after retransmission timeout may
+        // acknowledge any of the retransmitted messages so it is not sampled.
+        // Responses slower than current estimate are not sampled either, the
+        // estimate would otherwise follow retransmitted messages once it shrinks.
+        RttAddSample(rtt);
+    }
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+
+    TransactionFinish(&sPublishTransaction, aCode);
+}
+
+static void Publish(otInstance *instance)
+{
+    const char* data = "{\"temperature\":24.0}";
+    int32_t length = strlen(data);
+
+    // Previous message is still waiting for PUBACK, skip this period
+    if (sPublishTransaction.mIsPending)
+    {
+        return;
+    }
+    TransactionStart(&sPublishTransaction);
+    if (otMqttsnPublish(instance, (const uint8_t*)data, length, kQos1, false, &sTopic,
+        HandlePublished, NULL) != OT_ERROR_NONE)
+    {
+        sPublishTransaction.mIsPending = false;
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    // Handle registered
+    otInstance *instance = (otInstance *)aContext;
+
+    TransactionFinish(&sRegisterTransaction, aCode);
+    if (aCode == kCodeAccepted)
+    {
+        // Start periodic publishing to the registered topic
+        sTopic = *aTopic;
+        sTopicRegistered = true;
+        sNextPublishAt = otPlatAlarmMilliGetNow() + PUBLISH_INTERVAL_MS;
+        Publish(instance);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Handle connected
+    otInstance *instance = (otInstance *)aContext;
+
+    TransactionFinish(&sConnectTransaction, aCode);
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID
+        TransactionStart(&sRegisterTransaction);
+        otMqttsnRegister(instance, TOPIC_NAME, HandleRegistered, (void *)instance);
+    }
+}
+
+static void MqttsnConnect(otInstance *instance, bool aCleanSession);
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    // Handle disconnect
+    otInstance *instance = (otInstance *)aContext;
+
+    sTopicRegistered = false;
+    if (sReapplyTimeout)
+    {
+        // Disconnected to change retransmission timeout, session is kept by the gateway
+        sReapplyTimeout = false;
+        MqttsnConnect(instance, false);
+    }
+}
+
+static void MqttsnConnect(otInstance *instance, bool aCleanSession)
+{
+    otIp6Address address;
+    otIp6AddressFromString(GATEWAY_ADDRESS, &address);
+
+    // Set MQTT-SN client configuration settings
+    // Retransmission timeout estimated from previous transactions is rounded up to whole seconds.
+    // Client applies it only on connect, see ReapplyTimeout.
+    otMqttsnConfig config;
+    config.mClientId = CLIENT_ID;
+    config.mKeepAlive = 30;
+    config.mCleanSession = aCleanSession;
+    config.mPort = GATEWAY_PORT;
+    config.mAddress = &address;
+    config.mRetransmissionCount = RETRANSMISSION_COUNT;
+    sConfiguredTimeout = GetConfigurableTimeout();
+    config.mRetransmissionTimeout = sConfiguredTimeout / 1000;
+
+    // Register connected and disconnected callbacks
+    otMqttsnSetConnectedHandler(instance, HandleConnected, (void *)instance);
+    otMqttsnSetDisconnectedHandler(instance, HandleDisconnected, (void *)instance);
+    // Connect to the MQTT broker (gateway)
+    TransactionStart(&sConnectTransaction);
+    otMqttsnConnect(instance, &config);
+}
+
+static void ReapplyTimeout(otInstance *instance)
+{
+    // Client has no API to change retransmission timeout of established connection.
+    // When estimate drifts from configured value, connect again without clean session
+    // between publish periods, topic is registered again in connected handler.
+    if (!sTopicRegistered || sReapplyTimeout || sPublishTransaction.mIsPending || !IsTimeoutDrifted())
+    {
+        return;
+    }
+    if (otMqttsnDisconnect(instance) == OT_ERROR_NONE)
+    {
+        sTopicRegistered = false;
+        sReapplyTimeout = true;
+    }
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    otInstance *instance = (otInstance *)aContext;
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = otThreadGetDeviceRole(instance);
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_ROUTER)
+            && otMqttsnGetState(instance) == kStateDisconnected)
+        {
+            MqttsnConnect(instance, true);
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    otExtendedPanId extendedPanid;
+    otMasterKey masterKey;
+    otInstance *instance;
+
+    otSysInit(aArgc, aArgv);
+    instance = otInstanceInitSingle();
+    RttInit();
+
+    // Set default network settings
+    // Set network name
+    error = otThreadSetNetworkName(instance, NETWORK_NAME);
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    error = otThreadSetExtendedPanId(instance, &extendedPanid);
+    // Set PANID
+    error = otLinkSetPanId(instance, PANID);
+    // Set channel
+    error = otLinkSetChannel(instance, DEFAULT_CHANNEL);
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    error = otThreadSetMasterKey(instance, &masterKey);
+
+    // Register notifier callback to receive thread role changed events
+    error = otSetStateChangedCallback(instance, StateChanged, instance);
+
+    // Start thread network
+    otIp6SetSlaacEnabled(instance, true);
+    error = otIp6SetEnabled(instance, true);
+    error = otThreadSetEnabled(instance, true);
+
+    // Start MQTT-SN client
+    error = otMqttsnStart(instance, CLIENT_PORT);
+
+    while (true)
+    {
+        otTaskletsProcess(instance);
+        otSysProcessDrivers(instance);
+        // Publish when scheduled time passed, difference is wraparound safe
+        if (sTopicRegistered && (int32_t)(otPlatAlarmMilliGetNow() - sNextPublishAt) >= 0)
+        {
+            Publish(instance);
+            sNextPublishAt += PUBLISH_INTERVAL_MS;
+        }
+        ReapplyTimeout(instance);
+    }
+    return error;
+}
+
+void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Host benchmark of MQTT-SN codec measuring encode and decode time per message.
+// Build and run: cc -std=c99 -O2 -o codec_benchmark codec_benchmark.c && ./codec_benchmark
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "mqttsn_codec.h"
+
+#define ITERATIONS 10000000
+
+static uint64_t GetNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void Benchmark(const char *aName, const MqttsnCodecMessage *aMessage)
+{
+    uint8_t buffer[512];
+    MqttsnCodecMessage decoded;
+    uint16_t length = 0;
+    uint32_t checksum = 0;
+    uint64_t start;
+    uint64_t encodeNs;
+    uint64_t decodeNs;
+
+    memset(&decoded, 0, sizeof(decoded));
+
+    start = GetNowNs();
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        // Prevent compiler from hoisting encoding out of the loop
+        __asm__ volatile("" : : "r"(buffer) : "memory");
+        length = MqttsnCodecEncode(aMessage, buffer, sizeof(buffer));
+        checksum += length;
+    }
+    encodeNs = GetNowNs() - start;
+
+    start = GetNowNs();
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        __asm__ volatile("" : : "r"(buffer) : "memory");
+        checksum += MqttsnCodecDecode(buffer, length, &decoded);
+        checksum += decoded.mMessageId;
+    }
+    decodeNs = GetNowNs() - start;
+
+    printf("%-12s %4u bytes  encode %6.2f ns  decode %6.2f ns  (%u)\n", aName, (unsigned int)length,
+        (double)encodeNs / ITERATIONS, (double)decodeNs / ITERATIONS, (unsigned int)checksum);
+}
+
+int main(void)
+{
+    static const uint8_t payload[] = "{\"temperature\":24.0}";
+    static uint8_t largePayload[300];
+    MqttsnCodecMessage message;
+
+    memset(&message, 0, sizeof(message));
+    message.mType = kCodecConnect;
+    message.mFlags = 0x04;
+    message.mProtocolId = 0x01;
+    message.mDuration = 30;
+    message.mData = (const uint8_t *)"THREAD";
+    message.mDataLength = 6;
+    Benchmark("CONNECT", &message);
+
+    memset(&message, 0, sizeof(message));
+    message.mType = kCodecRegister;
+    message.mMessageId = 1;
+    message.mData = (const uint8_t *)"sensors";
+    message.mDataLength = 7;
+    Benchmark("REGISTER", &message);
+
+    memset(&message, 0, sizeof(message));
+    message.mType = kCodecPublish;
+    message.mFlags = 0x20;
+    message.mTopicId = 1;
+    message.mMessageId = 2;
+    message.mData = payload;
+    message.mDataLength = sizeof(payload) - 1;
+    Benchmark("PUBLISH", &message);
+
+    message.mData = largePayload;
+    message.mDataLength = sizeof(largePayload);
+    Benchmark("PUBLISH 300B", &message);
+
+    memset(&message, 0, sizeof(message));
+    message.mType = kCodecPuback;
+    message.mTopicId = 1;
+    message.mMessageId = 2;
+    Benchmark("PUBACK", &message);
+
+    memset(&message, 0, sizeof(message));
+    message.mType = kCodecPingreq;
+    Benchmark("PINGREQ", &message);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// libFuzzer harness of MQTT-SN codec. Every input which decodes successfully is
+// encoded again and the result must decode to the same message.
+// Build and run: clang -std=c99 -g -O1 -fsanitize=fuzzer,address,undefined -o codec_fuzz codec_fuzz.c && ./codec_fuzz
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "mqttsn_codec.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *aData, size_t aSize);
+
+static bool MessageEquals(const MqttsnCodecMessage *aMessage, const MqttsnCodecMessage *aOther)
+{
+    return aMessage->mType == aOther->mType && aMessage->mFlags == aOther->mFlags
+        && aMessage->mProtocolId == aOther->mProtocolId && aMessage->mGatewayId == aOther->mGatewayId
+        && aMessage->mRadius == aOther->mRadius && aMessage->mReturnCode == aOther->mReturnCode
+        && aMessage->mDuration == aOther->mDuration && aMessage->mTopicId == aOther->mTopicId
+        && aMessage->mMessageId == aOther->mMessageId && aMessage->mDataLength == aOther->mDataLength
+        && (aMessage->mDataLength == 0 || memcmp(aMessage->mData, aOther->mData, aMessage->mDataLength) == 0);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *aData, size_t aSize)
+{
+    static uint8_t buffer[0xffff];
+    MqttsnCodecMessage message;
+    MqttsnCodecMessage decoded;
+    uint16_t length;
+
+    // Decoder takes at most 16-bit length as MQTT-SN messages do
+    if (aSize > 0xffff)
+    {
+        return 0;
+    }
+    memset(&message, 0, sizeof(message));
+    memset(&decoded, 0, sizeof(decoded));
+    if (!MqttsnCodecDecode(aData, (uint16_t)aSize, &message))
+    {
+        return 0;
+    }
+    length = MqttsnCodecEncode(&message, buffer, sizeof(buffer));
+    // Decoded message always fits, it was read from buffer of the same size limit
+    if (length == 0 || !MqttsnCodecDecode(buffer, length, &decoded) || !MessageEquals(&message, &decoded))
+    {
+        abort();
+    }
+    return 0;
+}
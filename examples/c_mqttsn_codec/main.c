@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/tasklet.h"
+#include "openthread/ip6.h"
+#include "openthread/udp.h"
+#include "openthread/message.h"
+#include "openthread/dataset.h"
+#include "openthread/link.h"
+#include "openthread-system.h"
+
+#include "mqttsn_codec.h"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Predefined topic ID configured on the gateway
+#define TOPIC_ID 1
+// PUBLISH flags for QoS -1 and predefined topic ID
+#define PUBLISH_FLAGS_QOSM1_PREDEFINED 0x61
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static otUdpSocket sSocket;
+static uint8_t sGatewayId = 0;
+
+static void HandleUdpReceive(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    OT_UNUSED_VARIABLE(aMessageInfo);
+    uint8_t header[CODEC_MAX_HEADER_SIZE];
+    MqttsnCodecMessage message;
+    uint16_t offset = otMessageGetOffset(aMessage);
+    uint16_t length = otMessageGetLength(aMessage) - offset;
+    uint16_t headerLength = otMessageRead(aMessage, offset, header, sizeof(header));
+    uint16_t dataOffset;
+
+    // Only fixed header is copied, variable part stays in the message at
+    // offset + dataOffset and can be read by otMessageRead when it is needed
+    dataOffset = MqttsnCodecDecodeHeader(header, headerLength, length, &message);
+    if (dataOffset == 0)
+    {
+        return;
+    }
+    if (message.mType == kCodecAdvertise || message.mType == kCodecGwInfo)
+    {
+        // Handle gateway announcement
+        sGatewayId = message.mGatewayId;
+    }
+}
+
+static void Publish(otInstance *instance)
+{
+    // Publish data with QoS level -1 encoded by codec directly to UDP message
+    // No MQTT-SN client and no connection establishment is needed
+    const char* data = "{\"temperature\":24.0}";
+    uint8_t header[CODEC_MAX_HEADER_SIZE];
+    uint16_t headerLength;
+    MqttsnCodecMessage publish;
+    otMessageInfo messageInfo;
+    otMessage *message;
+
+    // Only header is encoded, payload is appended to UDP message from where it is stored
+    memset(&publish, 0, sizeof(publish));
+    publish.mType = kCodecPublish;
+    publish.mFlags = PUBLISH_FLAGS_QOSM1_PREDEFINED;
+    publish.mTopicId = TOPIC_ID;
+    publish.mDataLength = (uint16_t)strlen(data);
+    headerLength = MqttsnCodecEncodeHeader(&publish, header, sizeof(header));
+    if (headerLength == 0)
+    {
+        return;
+    }
+
+    message = otUdpNewMessage(instance, NULL);
+    if (message == NULL)
+    {
+        return;
+    }
+    memset(&messageInfo, 0, sizeof(messageInfo));
+    otIp6AddressFromString(GATEWAY_ADDRESS, &messageInfo.mPeerAddr);
+    messageInfo.mPeerPort = GATEWAY_PORT;
+    if (otMessageAppend(message, header, headerLength) != OT_ERROR_NONE
+        || otMessageAppend(message, data, publish.mDataLength) != OT_ERROR_NONE
+        || otUdpSend(&sSocket, message, &messageInfo) != OT_ERROR_NONE)
+    {
+        otMessageFree(message);
+    }
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    otInstance *instance = (otInstance *)aContext;
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = otThreadGetDeviceRole(instance);
+        // If role changed to any of active roles then publish
+        if (role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_ROUTER)
+        {
+            Publish(instance);
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    otExtendedPanId extendedPanid;
+    otMasterKey masterKey;
+    otInstance *instance;
+
+    otSysInit(aArgc, aArgv);
+    instance = otInstanceInitSingle();
+
+    // Set default network settings
+    // Set network name
+    error = otThreadSetNetworkName(instance, NETWORK_NAME);
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    error = otThreadSetExtendedPanId(instance, &extendedPanid);
+    // Set PANID
+    error = otLinkSetPanId(instance, PANID);
+    // Set channel
+    error = otLinkSetChannel(instance, DEFAULT_CHANNEL);
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    error = otThreadSetMasterKey(instance, &masterKey);
+
+    // Register notifier callback to receive thread role changed events
+    error = otSetStateChangedCallback(instance, StateChanged, instance);
+
+    // Start thread network
+    otIp6SetSlaacEnabled(instance, true);
+    error = otIp6SetEnabled(instance, true);
+    error = otThreadSetEnabled(instance, true);
+
+    // Open UDP socket for MQTT-SN messages
+    otSockAddr sockAddr;
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.mPort = CLIENT_PORT;
+    error = otUdpOpen(instance, &sSocket, HandleUdpReceive, instance);
+    error = otUdpBind(&sSocket, &sockAddr);
+
+    while (true)
+    {
+        otTaskletsProcess(instance);
+        otSysProcessDrivers(instance);
+    }
+    return error;
+}
+
+void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,369 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MQTTSN_CODEC_H_
+#define MQTTSN_CODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Allocation free MQTT-SN v1.2 message codec. Layout of every message type is
+// described by constant table, so encoder and decoder check buffer size once
+// per message and then access fields without further bounds checks. Variable
+// part of decoded message points directly into the source buffer.
+
+// Field kind value also carries field size in upper nibble
+enum
+{
+    kCodecFieldNone = 0x00,
+    kCodecFieldFlags = 0x11,
+    kCodecFieldProtocolId = 0x12,
+    kCodecFieldGatewayId = 0x13,
+    kCodecFieldRadius = 0x14,
+    kCodecFieldReturnCode = 0x15,
+    kCodecFieldDuration = 0x26,
+    kCodecFieldTopicId = 0x27,
+    kCodecFieldMessageId = 0x28
+};
+
+#define CODEC_FIELD_SIZE(aField) ((aField) >> 4)
+#define CODEC_MAX_FIELDS 4
+#define CODEC_MAX_TYPE 0x1d
+// Three byte length, message type and the largest fixed part (SUBACK)
+#define CODEC_MAX_HEADER_SIZE 10
+
+typedef enum MqttsnCodecType
+{
+    kCodecAdvertise = 0x00,
+    kCodecSearchGw = 0x01,
+    kCodecGwInfo = 0x02,
+    kCodecConnect = 0x04,
+    kCodecConnack = 0x05,
+    kCodecWillTopicReq = 0x06,
+    kCodecWillTopic = 0x07,
+    kCodecWillMsgReq = 0x08,
+    kCodecWillMsg = 0x09,
+    kCodecRegister = 0x0a,
+    kCodecRegack = 0x0b,
+    kCodecPublish = 0x0c,
+    kCodecPuback = 0x0d,
+    kCodecPubcomp = 0x0e,
+    kCodecPubrec = 0x0f,
+    kCodecPubrel = 0x10,
+    kCodecSubscribe = 0x12,
+    kCodecSuback = 0x13,
+    kCodecUnsubscribe = 0x14,
+    kCodecUnsuback = 0x15,
+    kCodecPingreq = 0x16,
+    kCodecPingresp = 0x17,
+    kCodecDisconnect = 0x18,
+    kCodecWillTopicUpd = 0x1a,
+    kCodecWillTopicResp = 0x1b,
+    kCodecWillMsgUpd = 0x1c,
+    kCodecWillMsgResp = 0x1d
+} MqttsnCodecType;
+
+typedef struct MqttsnCodecLayout
+{
+    uint8_t mFields[CODEC_MAX_FIELDS];
+    uint8_t mFixedSize;
+    bool mHasData;
+    bool mIsValid;
+} MqttsnCodecLayout;
+
+// All fields of any message type, only fields present in the layout are used.
+// Data is variable part: client ID, topic name, payload, gateway address,
+// topic of SUBSCRIBE/UNSUBSCRIBE or optional duration of DISCONNECT.
+typedef struct MqttsnCodecMessage
+{
+    uint8_t mType;
+    uint8_t mFlags;
+    uint8_t mProtocolId;
+    uint8_t mGatewayId;
+    uint8_t mRadius;
+    uint8_t mReturnCode;
+    uint16_t mDuration;
+    uint16_t mTopicId;
+    uint16_t mMessageId;
+    const uint8_t *mData;
+    uint16_t mDataLength;
+} MqttsnCodecMessage;
+
+#define CODEC_LAYOUT(aHasData, aField1, aField2, aField3, aField4) \
+    { { aField1, aField2, aField3, aField4 }, \
+      CODEC_FIELD_SIZE(aField1) + CODEC_FIELD_SIZE(aField2) + CODEC_FIELD_SIZE(aField3) + CODEC_FIELD_SIZE(aField4), \
+      aHasData, true }
+#define CODEC_LAYOUT_INVALID { { 0, 0, 0, 0 }, 0, false, false }
+
+static const MqttsnCodecLayout kCodecLayouts[CODEC_MAX_TYPE + 1] = {
+    /* ADVERTISE */ CODEC_LAYOUT(false, kCodecFieldGatewayId, kCodecFieldDuration, kCodecFieldNone, kCodecFieldNone),
+    /* SEARCHGW */ CODEC_LAYOUT(false, kCodecFieldRadius, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* GWINFO */ CODEC_LAYOUT(true, kCodecFieldGatewayId, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* 0x03 */ CODEC_LAYOUT_INVALID,
+    /* CONNECT */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldProtocolId, kCodecFieldDuration, kCodecFieldNone),
+    /* CONNACK */ CODEC_LAYOUT(false, kCodecFieldReturnCode, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLTOPICREQ */ CODEC_LAYOUT(false, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLTOPIC */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLMSGREQ */ CODEC_LAYOUT(false, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLMSG */ CODEC_LAYOUT(true, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* REGISTER */ CODEC_LAYOUT(true, kCodecFieldTopicId, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone),
+    /* REGACK */ CODEC_LAYOUT(false, kCodecFieldTopicId, kCodecFieldMessageId, kCodecFieldReturnCode, kCodecFieldNone),
+    /* PUBLISH */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldTopicId, kCodecFieldMessageId, kCodecFieldNone),
+    /* PUBACK */ CODEC_LAYOUT(false, kCodecFieldTopicId, kCodecFieldMessageId, kCodecFieldReturnCode, kCodecFieldNone),
+    /* PUBCOMP */ CODEC_LAYOUT(false, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* PUBREC */ CODEC_LAYOUT(false, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* PUBREL */ CODEC_LAYOUT(false, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* 0x11 */ CODEC_LAYOUT_INVALID,
+    /* SUBSCRIBE */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone),
+    /* SUBACK */ CODEC_LAYOUT(false, kCodecFieldFlags, kCodecFieldTopicId, kCodecFieldMessageId, kCodecFieldReturnCode),
+    /* UNSUBSCRIBE */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone),
+    /* UNSUBACK */ CODEC_LAYOUT(false, kCodecFieldMessageId, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* PINGREQ */ CODEC_LAYOUT(true, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* PINGRESP */ CODEC_LAYOUT(false, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* DISCONNECT */ CODEC_LAYOUT(true, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* 0x19 */ CODEC_LAYOUT_INVALID,
+    /* WILLTOPICUPD */ CODEC_LAYOUT(true, kCodecFieldFlags, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLTOPICRESP */ CODEC_LAYOUT(false, kCodecFieldReturnCode, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLMSGUPD */ CODEC_LAYOUT(true, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone),
+    /* WILLMSGRESP */ CODEC_LAYOUT(false, kCodecFieldReturnCode, kCodecFieldNone, kCodecFieldNone, kCodecFieldNone)
+};
+
+static inline const MqttsnCodecLayout *MqttsnCodecGetLayout(uint8_t aType)
+{
+    return (aType <= CODEC_MAX_TYPE && kCodecLayouts[aType].mIsValid) ? &kCodecLayouts[aType] : NULL;
+}
+
+// Encode length, type and fixed fields of message to buffer. Length field
+// covers mDataLength bytes of data which are not written, so the caller can
+// append data from where it is stored. Returns header length or 0 when message
+// type is invalid or buffer is too small.
+static inline uint16_t MqttsnCodecEncodeHeader(const MqttsnCodecMessage *aMessage, uint8_t *aBuffer, uint16_t aBufferSize)
+{
+    const MqttsnCodecLayout *layout = MqttsnCodecGetLayout(aMessage->mType);
+    uint16_t dataLength;
+    uint32_t length;
+    uint16_t headerLength;
+    uint8_t *cursor = aBuffer;
+
+    if (layout == NULL)
+    {
+        return 0;
+    }
+    dataLength = layout->mHasData ? aMessage->mDataLength : 0;
+    length = 2 + layout->mFixedSize + dataLength;
+    // Messages longer than 255 bytes use three byte length field
+    if (length > 255)
+    {
+        length += 2;
+    }
+    headerLength = (uint16_t)(length - dataLength);
+    if (headerLength > aBufferSize || length > 0xffff)
+    {
+        return 0;
+    }
+
+    if (length > 255)
+    {
+        *cursor++ = 0x01;
+        *cursor++ = (uint8_t)(length >> 8);
+        *cursor++ = (uint8_t)length;
+    }
+    else
+    {
+        *cursor++ = (uint8_t)length;
+    }
+    *cursor++ = aMessage->mType;
+    for (uint8_t i = 0; i < CODEC_MAX_FIELDS; i++)
+    {
+        switch (layout->mFields[i])
+        {
+        case kCodecFieldFlags:
+            *cursor++ = aMessage->mFlags;
+            break;
+        case kCodecFieldProtocolId:
+            *cursor++ = aMessage->mProtocolId;
+            break;
+        case kCodecFieldGatewayId:
+            *cursor++ = aMessage->mGatewayId;
+            break;
+        case kCodecFieldRadius:
+            *cursor++ = aMessage->mRadius;
+            break;
+        case kCodecFieldReturnCode:
+            *cursor++ = aMessage->mReturnCode;
+            break;
+        case kCodecFieldDuration:
+            *cursor++ = (uint8_t)(aMessage->mDuration >> 8);
+            *cursor++ = (uint8_t)aMessage->mDuration;
+            break;
+        case kCodecFieldTopicId:
+            *cursor++ = (uint8_t)(aMessage->mTopicId >> 8);
+            *cursor++ = (uint8_t)aMessage->mTopicId;
+            break;
+        case kCodecFieldMessageId:
+            *cursor++ = (uint8_t)(aMessage->mMessageId >> 8);
+            *cursor++ = (uint8_t)aMessage->mMessageId;
+            break;
+        default:
+            break;
+        }
+    }
+    return headerLength;
+}
+
+// Encode message to buffer, returns encoded length or 0 when message type is
+// invalid or buffer is too small
+static inline uint16_t MqttsnCodecEncode(const MqttsnCodecMessage *aMessage, uint8_t *aBuffer, uint16_t aBufferSize)
+{
+    const MqttsnCodecLayout *layout = MqttsnCodecGetLayout(aMessage->mType);
+    uint16_t headerLength = MqttsnCodecEncodeHeader(aMessage, aBuffer, aBufferSize);
+    uint16_t dataLength;
+
+    if (headerLength == 0)
+    {
+        return 0;
+    }
+    dataLength = layout->mHasData ? aMessage->mDataLength : 0;
+    if (dataLength > aBufferSize - headerLength)
+    {
+        return 0;
+    }
+    if (dataLength > 0)
+    {
+        memcpy(aBuffer + headerLength, aMessage->mData, dataLength);
+    }
+    return (uint16_t)(headerLength + dataLength);
+}
+
+// Decode length, type and fixed fields of message of aMessageLength bytes from
+// buffer which holds at least its first aBufferLength bytes, at most
+// CODEC_MAX_HEADER_SIZE bytes are needed. Data is not referenced, mData is set
+// to NULL and mDataLength to its length. Returns offset of data from the start
+// of the message or 0 when message is malformed or of unsupported type.
+static inline uint16_t MqttsnCodecDecodeHeader(const uint8_t *aBuffer, uint16_t aBufferLength, uint16_t aMessageLength,
+    MqttsnCodecMessage *aMessage)
+{
+    const MqttsnCodecLayout *layout;
+    const uint8_t *cursor = aBuffer;
+    uint16_t length;
+    uint16_t headerLength;
+
+    if (aBufferLength > aMessageLength)
+    {
+        aBufferLength = aMessageLength;
+    }
+    if (aBufferLength < 2)
+    {
+        return 0;
+    }
+    if (aBuffer[0] == 0x01)
+    {
+        if (aBufferLength < 4)
+        {
+            return 0;
+        }
+        length = (uint16_t)((aBuffer[1] << 8) | aBuffer[2]);
+        headerLength = 4;
+    }
+    else
+    {
+        length = aBuffer[0];
+        headerLength = 2;
+    }
+    if (length < headerLength || length > aMessageLength)
+    {
+        return 0;
+    }
+    cursor += headerLength - 1;
+    aMessage->mType = *cursor++;
+    layout = MqttsnCodecGetLayout(aMessage->mType);
+    // Single size check for the whole fixed part of the message
+    if (layout == NULL || length - headerLength < layout->mFixedSize
+        || (!layout->mHasData && length - headerLength != layout->mFixedSize)
+        || aBufferLength - headerLength < layout->mFixedSize)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < CODEC_MAX_FIELDS; i++)
+    {
+        switch (layout->mFields[i])
+        {
+        case kCodecFieldFlags:
+            aMessage->mFlags = *cursor++;
+            break;
+        case kCodecFieldProtocolId:
+            aMessage->mProtocolId = *cursor++;
+            break;
+        case kCodecFieldGatewayId:
+            aMessage->mGatewayId = *cursor++;
+            break;
+        case kCodecFieldRadius:
+            aMessage->mRadius = *cursor++;
+            break;
+        case kCodecFieldReturnCode:
+            aMessage->mReturnCode = *cursor++;
+            break;
+        case kCodecFieldDuration:
+            aMessage->mDuration = (uint16_t)((cursor[0] << 8) | cursor[1]);
+            cursor += 2;
+            break;
+        case kCodecFieldTopicId:
+            aMessage->mTopicId = (uint16_t)((cursor[0] << 8) | cursor[1]);
+            cursor += 2;
+            break;
+        case kCodecFieldMessageId:
+            aMessage->mMessageId = (uint16_t)((cursor[0] << 8) | cursor[1]);
+            cursor += 2;
+            break;
+        default:
+            break;
+        }
+    }
+    headerLength = (uint16_t)(cursor - aBuffer);
+    aMessage->mData = NULL;
+    aMessage->mDataLength = (uint16_t)(length - headerLength);
+    return headerLength;
+}
+
+// Decode message from buffer, data of decoded message points into the buffer.
+// Returns false when message is malformed or of unsupported type.
+static inline bool MqttsnCodecDecode(const uint8_t *aBuffer, uint16_t aLength, MqttsnCodecMessage *aMessage)
+{
+    uint16_t headerLength = MqttsnCodecDecodeHeader(aBuffer, aLength, aLength, aMessage);
+
+    if (headerLength == 0)
+    {
+        return false;
+    }
+    aMessage->mData = aBuffer + headerLength;
+    return true;
+}
+
+#endif // MQTTSN_CODEC_H_
@@ -0,0 +1,317 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/tasklet.h"
+#include "openthread/ip6.h"
+#include "openthread/mqttsn.h"
+#include "openthread/dataset.h"
+#include "openthread/link.h"
+#include "openthread/platform/alarm-milli.h"
+#include "openthread-system.h"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// Maximal number of QoS 1 messages waiting for PUBACK at the same time
+#define PUBLISH_WINDOW_SIZE 4
+// Number of messages published by this example
+#define PUBLISH_COUNT 32
+// Maximal number of attempts to deliver one message when client retransmissions time out
+#define PUBLISH_MAX_ATTEMPTS 3
+#define PAYLOAD_MAX_LENGTH 48
+// Delay before publishing is retried when no message buffer was available for empty window
+#define REFILL_RETRY_DELAY_MS 1000
+
+// Slot of the in-flight window. Slot pointer is passed as callback context
+// so PUBACKs are matched to the message no matter in which order they arrive.
+typedef struct InFlightMessage
+{
+    bool mIsUsed;
+    uint16_t mSequence;
+    uint8_t mAttempts;
+} InFlightMessage;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static otInstance *sInstance = NULL;
+static otMqttsnTopic sTopic;
+static InFlightMessage sWindow[PUBLISH_WINDOW_SIZE];
+static uint8_t sInFlightCount = 0;
+static uint16_t sNextSequence = 0;
+static uint16_t sDeliveredCount = 0;
+static uint16_t sFailedCount = 0;
+static uint16_t sRetransmittedCount = 0;
+static bool sTopicRegistered = false;
+static bool sRefillPending = false;
+static uint32_t sRefillAt = 0;
+
+static void FillWindow(void);
+static otError PublishSlot(InFlightMessage *aSlot);
+
+static uint8_t GetInFlightCount(void)
+{
+    // Report current depth of the in-flight window
+    return sInFlightCount;
+}
+
+static void ReleaseSlot(InFlightMessage *aSlot)
+{
+    aSlot->mIsUsed = false;
+    sInFlightCount--;
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    InFlightMessage *slot = (InFlightMessage *)aContext;
+    // Handle published
+
+    if (!slot->mIsUsed)
+    {
+        // Slot was already released on disconnect
+        return;
+    }
+
+    if (aCode == kCodeAccepted)
+    {
+        sDeliveredCount++;
+        ReleaseSlot(slot);
+    }
+    else if (slot->mAttempts < PUBLISH_MAX_ATTEMPTS && PublishSlot(slot) == OT_ERROR_NONE)
+    {
+        // Client gave up retransmitting or gateway is congested, keep the slot and send message again
+        sRetransmittedCount++;
+    }
+    else
+    {
+        sFailedCount++;
+        ReleaseSlot(slot);
+    }
+
+    // Acknowledged slot may be reused immediately
+    FillWindow();
+}
+
+static otError PublishSlot(InFlightMessage *aSlot)
+{
+    char data[PAYLOAD_MAX_LENGTH];
+    int32_t length = snprintf(data, sizeof(data), "{\"seq\":%u,\"temperature\":24.0}",
+        (unsigned int)aSlot->mSequence);
+    aSlot->mAttempts++;
+    return otMqttsnPublish(sInstance, (const uint8_t*)data, length, kQos1, false, &sTopic,
+        HandlePublished, aSlot);
+}
+
+static void FillWindow(void)
+{
+    // Publish new messages until all window slots are waiting for PUBACK
+    for (uint8_t i = 0; i < PUBLISH_WINDOW_SIZE && GetInFlightCount() < PUBLISH_WINDOW_SIZE
+        && sNextSequence < PUBLISH_COUNT; i++)
+    {
+        InFlightMessage *slot = &sWindow[i];
+        if (slot->mIsUsed)
+        {
+            continue;
+        }
+        slot->mIsUsed = true;
+        slot->mSequence = sNextSequence;
+        slot->mAttempts = 0;
+        if (PublishSlot(slot) != OT_ERROR_NONE)
+        {
+            // Not enough buffers, try again when next PUBACK releases a slot. There is no PUBACK
+            // to wait for when the window is empty so retry after a delay.
+            slot->mIsUsed = false;
+            if (GetInFlightCount() == 0)
+            {
+                sRefillPending = true;
+                sRefillAt = otPlatAlarmMilliGetNow() + REFILL_RETRY_DELAY_MS;
+            }
+            break;
+        }
+        sInFlightCount++;
+        sNextSequence++;
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Start pipelined publishing to the registered topic
+        sTopic = *aTopic;
+        sTopicRegistered = true;
+        FillWindow();
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Handle connected
+    otInstance *instance = (otInstance *)aContext;
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID
+        otMqttsnRegister(instance, TOPIC_NAME, HandleRegistered, (void *)instance);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    // Messages waiting for PUBACK are lost with the session, release their slots
+    for (uint8_t i = 0; i < PUBLISH_WINDOW_SIZE; i++)
+    {
+        if (sWindow[i].mIsUsed)
+        {
+            sWindow[i].mIsUsed = false;
+            sFailedCount++;
+        }
+    }
+    sInFlightCount = 0;
+    sTopicRegistered = false;
+    sRefillPending = false;
+}
+
+static void MqttsnConnect(otInstance *instance)
+{
+    otIp6Address address;
+    otIp6AddressFromString(GATEWAY_ADDRESS, &address);
+
+    // Set MQTT-SN client configuration settings
+    otMqttsnConfig config;
+    config.mClientId = CLIENT_ID;
+    config.mKeepAlive = 30;
+    config.mCleanSession = true;
+    config.mPort = GATEWAY_PORT;
+    config.mAddress = &address;
+    config.mRetransmissionCount = 3;
+    config.mRetransmissionTimeout = 10;
+
+    // Register connected and disconnected callbacks
+    otMqttsnSetConnectedHandler(instance, HandleConnected, (void *)instance);
+    otMqttsnSetDisconnectedHandler(instance, HandleDisconnected, (void *)instance);
+    // Connect to the MQTT broker (gateway)
+    otMqttsnConnect(instance, &config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    otInstance *instance = (otInstance *)aContext;
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = otThreadGetDeviceRole(instance);
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_ROUTER)
+            && otMqttsnGetState(instance) == kStateDisconnected)
+        {
+            MqttsnConnect(instance);
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    otExtendedPanId extendedPanid;
+    otMasterKey masterKey;
+    otInstance *instance;
+
+    otSysInit(aArgc, aArgv);
+    instance = otInstanceInitSingle();
+    sInstance = instance;
+
+    // Set default network settings
+    // Set network name
+    error = otThreadSetNetworkName(instance, NETWORK_NAME);
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    error = otThreadSetExtendedPanId(instance, &extendedPanid);
+    // Set PANID
+    error = otLinkSetPanId(instance, PANID);
+    // Set channel
+    error = otLinkSetChannel(instance, DEFAULT_CHANNEL);
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    error = otThreadSetMasterKey(instance, &masterKey);
+
+    // Register notifier callback to receive thread role changed events
+    error = otSetStateChangedCallback(instance, StateChanged, instance);
+
+    // Start thread network
+    otIp6SetSlaacEnabled(instance, true);
+    error = otIp6SetEnabled(instance, true);
+    error = otThreadSetEnabled(instance, true);
+
+    // Start MQTT-SN client
+    error = otMqttsnStart(instance, CLIENT_PORT);
+
+    while (true)
+    {
+        otTaskletsProcess(instance);
+        otSysProcessDrivers(instance);
+        // Retry publishing when scheduled time passed, difference is wraparound safe
+        if (sTopicRegistered && sRefillPending && (int32_t)(otPlatAlarmMilliGetNow() - sRefillAt) >= 0)
+        {
+            sRefillPending = false;
+            FillWindow();
+        }
+    }
+    return error;
+}
+
+void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,349 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/tasklet.h"
+#include "openthread/ip6.h"
+#include "openthread/mqttsn.h"
+#include "openthread/dataset.h"
+#include "openthread/link.h"
+#include "openthread-system.h"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Maximal number of requests in one batch
+#define BATCH_MAX_SIZE 16
+
+struct Batch;
+
+typedef void (*BatchHandler)(const struct Batch *aBatch, void* aContext);
+
+// Result of one REGISTER or SUBSCRIBE request in the batch
+typedef struct BatchItem
+{
+    struct Batch *mBatch;
+    otMqttsnReturnCode mCode;
+    otMqttsnTopic mTopic;
+    otMqttsnQos mQos;
+} BatchItem;
+
+// All requests are sent back-to-back, each with its own message ID assigned
+// by the client. Item pointer is used as callback context so REGACK and SUBACK
+// may arrive in any order. Completion callback is called once for the batch.
+typedef struct Batch
+{
+    BatchItem mItems[BATCH_MAX_SIZE];
+    uint8_t mCount;
+    uint8_t mPendingCount;
+    uint8_t mAcceptedCount;
+    BatchHandler mCallback;
+    void* mContext;
+} Batch;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// Topics published by the device
+static const char* sSensorTopicNames[] = {
+    "building/floor1/room12/sensors/temperature",
+    "building/floor1/room12/sensors/humidity",
+    "building/floor1/room12/sensors/pressure",
+    "building/floor1/room12/sensors/co2",
+};
+
+// Topics with commands for the device
+static const char* sControlTopicNames[] = {
+    "building/floor1/room12/control/config",
+    "building/floor1/room12/control/reset",
+};
+
+static Batch sRegisterBatch;
+static Batch sSubscribeBatch;
+
+static void BatchInit(Batch *aBatch, uint8_t aCount, BatchHandler aCallback, void* aContext)
+{
+    memset(aBatch, 0, sizeof(*aBatch));
+    aBatch->mCount = aCount;
+    // One extra pending count guards the batch until all requests are sent
+    aBatch->mPendingCount = aCount + 1;
+    aBatch->mCallback = aCallback;
+    aBatch->mContext = aContext;
+}
+
+static void BatchRelease(Batch *aBatch)
+{
+    if (--aBatch->mPendingCount == 0)
+    {
+        aBatch->mCallback(aBatch, aBatch->mContext);
+    }
+}
+
+static void BatchItemFinished(BatchItem *aItem, otMqttsnReturnCode aCode)
+{
+    aItem->mCode = aCode;
+    if (aCode == kCodeAccepted)
+    {
+        aItem->mBatch->mAcceptedCount++;
+    }
+    BatchRelease(aItem->mBatch);
+}
+
+static void HandleBatchRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    BatchItem *item = (BatchItem *)aContext;
+
+    if (aCode == kCodeAccepted)
+    {
+        item->mTopic = *aTopic;
+    }
+    BatchItemFinished(item, aCode);
+}
+
+static void HandleBatchSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    BatchItem *item = (BatchItem *)aContext;
+
+    if (aCode == kCodeAccepted)
+    {
+        item->mTopic = *aTopic;
+        item->mQos = aQos;
+    }
+    BatchItemFinished(item, aCode);
+}
+
+static otError RegisterBatch(otInstance *aInstance, Batch *aBatch, const char* const* aTopicNames, uint8_t aCount,
+    BatchHandler aCallback, void* aContext)
+{
+    if (aCount == 0 || aCount > BATCH_MAX_SIZE)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    BatchInit(aBatch, aCount, aCallback, aContext);
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        BatchItem *item = &aBatch->mItems[i];
+        item->mBatch = aBatch;
+        if (otMqttsnRegister(aInstance, aTopicNames[i], HandleBatchRegistered, item) != OT_ERROR_NONE)
+        {
+            // Request was not sent, report it as rejected in batch result
+            BatchItemFinished(item, kCodeRejectedCongestion);
+        }
+    }
+    BatchRelease(aBatch);
+    return OT_ERROR_NONE;
+}
+
+static otError SubscribeBatch(otInstance *aInstance, Batch *aBatch, const otMqttsnTopic* aTopics, uint8_t aCount,
+    otMqttsnQos aQos, BatchHandler aCallback, void* aContext)
+{
+    if (aCount == 0 || aCount > BATCH_MAX_SIZE)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    BatchInit(aBatch, aCount, aCallback, aContext);
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        BatchItem *item = &aBatch->mItems[i];
+        item->mBatch = aBatch;
+        if (otMqttsnSubscribe(aInstance, &aTopics[i], aQos, HandleBatchSubscribed, item) != OT_ERROR_NONE)
+        {
+            // Request was not sent, report it as rejected in batch result
+            BatchItemFinished(item, kCodeRejectedCongestion);
+        }
+    }
+    BatchRelease(aBatch);
+    return OT_ERROR_NONE;
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from control topics
+
+    return kCodeAccepted;
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+}
+
+static void HandleRegisterBatch(const Batch *aBatch, void* aContext)
+{
+    // Handle all topics registered
+    otInstance *instance = (otInstance *)aContext;
+
+    // Publish initial value to every successfully registered topic
+    for (uint8_t i = 0; i < aBatch->mCount; i++)
+    {
+        const BatchItem *item = &aBatch->mItems[i];
+        if (item->mCode == kCodeAccepted)
+        {
+            const char* data = "{\"value\":0}";
+            int32_t length = strlen(data);
+            otMqttsnPublish(instance, (const uint8_t*)data, length, kQos1, false, &item->mTopic,
+                HandlePublished, NULL);
+        }
+    }
+}
+
+static void HandleSubscribeBatch(const Batch *aBatch, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aBatch);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle all control topics subscribed
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Handle connected
+    otInstance *instance = (otInstance *)aContext;
+    if (aCode == kCodeAccepted)
+    {
+        otMqttsnTopic controlTopics[sizeof(sControlTopicNames) / sizeof(sControlTopicNames[0])];
+        uint8_t controlCount = sizeof(sControlTopicNames) / sizeof(sControlTopicNames[0]);
+
+        // Set callback for received messages
+        otMqttsnSetPublishReceivedHandler(instance, HandlePublishReceived, instance);
+        // Obtain all topic IDs and subscribe control topics at once
+        RegisterBatch(instance, &sRegisterBatch, sSensorTopicNames,
+            sizeof(sSensorTopicNames) / sizeof(sSensorTopicNames[0]), HandleRegisterBatch, instance);
+        for (uint8_t i = 0; i < controlCount; i++)
+        {
+            controlTopics[i] = otMqttsnCreateTopicName(sControlTopicNames[i]);
+        }
+        SubscribeBatch(instance, &sSubscribeBatch, controlTopics, controlCount, kQos1, HandleSubscribeBatch, instance);
+    }
+}
+
+static void MqttsnConnect(otInstance *instance)
+{
+    otIp6Address address;
+    otIp6AddressFromString(GATEWAY_ADDRESS, &address);
+
+    // Set MQTT-SN client configuration settings
+    otMqttsnConfig config;
+    config.mClientId = CLIENT_ID;
+    config.mKeepAlive = 30;
+    config.mCleanSession = true;
+    config.mPort = GATEWAY_PORT;
+    config.mAddress = &address;
+    config.mRetransmissionCount = 3;
+    config.mRetransmissionTimeout = 10;
+
+    // Register connected callback
+    otMqttsnSetConnectedHandler(instance, HandleConnected, (void *)instance);
+    // Connect to the MQTT broker (gateway)
+    otMqttsnConnect(instance, &config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    otInstance *instance = (otInstance *)aContext;
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = otThreadGetDeviceRole(instance);
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_ROUTER)
+            && otMqttsnGetState(instance) == kStateDisconnected)
+        {
+            MqttsnConnect(instance);
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    otExtendedPanId extendedPanid;
+    otMasterKey masterKey;
+    otInstance *instance;
+
+    otSysInit(aArgc, aArgv);
+    instance = otInstanceInitSingle();
+
+    // Set default network settings
+    // Set network name
+    error = otThreadSetNetworkName(instance, NETWORK_NAME);
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    error = otThreadSetExtendedPanId(instance, &extendedPanid);
+    // Set PANID
+    error = otLinkSetPanId(instance, PANID);
+    // Set channel
+    error = otLinkSetChannel(instance, DEFAULT_CHANNEL);
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    error = otThreadSetMasterKey(instance, &masterKey);
+
+    // Register notifier callback to receive thread role changed events
+    error = otSetStateChangedCallback(instance, StateChanged, instance);
+
+    // Start thread network
+    otIp6SetSlaacEnabled(instance, true);
+    error = otIp6SetEnabled(instance, true);
+    error = otThreadSetEnabled(instance, true);
+
+    // Start MQTT-SN client
+    error = otMqttsnStart(instance, CLIENT_PORT);
+
+    while (true)
+    {
+        otTaskletsProcess(instance);
+        otSysProcessDrivers(instance);
+    }
+    return error;
+}
+
+void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,264 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/tasklet.h"
+#include "openthread/ip6.h"
+#include "openthread/mqttsn.h"
+#include "openthread/dataset.h"
+#include "openthread/link.h"
+#include "openthread/random_noncrypto.h"
+#include "openthread/platform/alarm-milli.h"
+#include "openthread-system.h"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_MULTICAST_PORT 10000
+#define GATEWAY_MULTICAST_ADDRESS "ff03::2"
+#define GATEWAY_MULTICAST_RADIUS 8
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Initial random delay window before own SEARCHGW message is sent
+#define SEARCHGW_DELAY_MIN_MS 5000
+// Upper bound of the delay window doubled after every unanswered search
+#define SEARCHGW_DELAY_MAX_MS 120000
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static otIp6Address sGatewayAddress;
+static bool sGatewayKnown = false;
+static bool sConnectPending = false;
+static bool sSearchScheduled = false;
+// Own SEARCHGW was sent and no gateway was discovered since then
+static bool sSearchOutstanding = false;
+static uint32_t sSearchAt = 0;
+static uint32_t sSearchDelayWindow = SEARCHGW_DELAY_MIN_MS;
+static uint32_t sSearchSentCount = 0;
+static uint32_t sSearchSuppressedCount = 0;
+
+static void ScheduleSearch(void);
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+    sConnectPending = false;
+    if (aCode != kCodeAccepted)
+    {
+        // Gateway is not usable anymore, it must be discovered again
+        sGatewayKnown = false;
+        ScheduleSearch();
+    }
+}
+
+static void MqttsnConnect(otInstance *instance)
+{
+    otIp6Address address = sGatewayAddress;
+
+    // Set MQTT-SN client configuration settings
+    otMqttsnConfig config;
+    config.mClientId = CLIENT_ID;
+    config.mKeepAlive = 30;
+    config.mCleanSession = true;
+    config.mPort = GATEWAY_MULTICAST_PORT;
+    config.mAddress = &address;
+    config.mRetransmissionCount = 3;
+    config.mRetransmissionTimeout = 10;
+
+    // Register connected callback
+    otMqttsnSetConnectedHandler(instance, HandleConnected, (void *)instance);
+    // Connect to the MQTT broker (gateway)
+    if (otMqttsnConnect(instance, &config) == OT_ERROR_NONE)
+    {
+        sConnectPending = true;
+    }
+}
+
+static void ScheduleSearch(void)
+{
+    if (sSearchScheduled)
+    {
+        return;
+    }
+    // Send SEARCHGW after random delay so nodes which changed role at the same
+    // time do not flood the mesh, other node's GWINFO may answer it meanwhile
+    sSearchAt = otPlatAlarmMilliGetNow() + otRandomNonCryptoGetUint32() % sSearchDelayWindow;
+    sSearchScheduled = true;
+}
+
+static void GatewayDiscovered(otInstance *instance, const otIp6Address *aAddress)
+{
+    sGatewayAddress = *aAddress;
+    sGatewayKnown = true;
+    sSearchDelayWindow = SEARCHGW_DELAY_MIN_MS;
+    if (sSearchScheduled && !sSearchOutstanding)
+    {
+        // Gateway was found by someone else, own search is not necessary
+        sSearchSuppressedCount++;
+    }
+    // Repeated search is not necessary either when own SEARCHGW was answered
+    sSearchScheduled = false;
+    sSearchOutstanding = false;
+    if (!sConnectPending && otMqttsnGetState(instance) == kStateDisconnected)
+    {
+        MqttsnConnect(instance);
+    }
+}
+
+static void HandleSearchGw(const otIp6Address* aAddress, uint8_t aGatewayId, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aGatewayId);
+    // Handle GWINFO message received, either response to own SEARCHGW or
+    // response to other client's search overheard on the multicast address
+    GatewayDiscovered((otInstance *)aContext, aAddress);
+}
+
+static void HandleAdvertise(const otIp6Address* aAddress, uint8_t aGatewayId, uint32_t aDuration, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aGatewayId);
+    OT_UNUSED_VARIABLE(aDuration);
+    // Handle ADVERTISE message periodically broadcasted by gateway
+    GatewayDiscovered((otInstance *)aContext, aAddress);
+}
+
+static void SearchGateway(otInstance *instance)
+{
+    otIp6Address address;
+    otIp6AddressFromString(GATEWAY_MULTICAST_ADDRESS, &address);
+
+    // Send SEARCHGW multicast message
+    if (otMqttsnSearchGateway(instance, &address, GATEWAY_MULTICAST_PORT, GATEWAY_MULTICAST_RADIUS) == OT_ERROR_NONE)
+    {
+        sSearchSentCount++;
+        sSearchOutstanding = true;
+    }
+    // Search again with longer delay if no GWINFO arrives
+    if (sSearchDelayWindow < SEARCHGW_DELAY_MAX_MS / 2)
+    {
+        sSearchDelayWindow *= 2;
+    }
+    else
+    {
+        sSearchDelayWindow = SEARCHGW_DELAY_MAX_MS;
+    }
+    ScheduleSearch();
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    otInstance *instance = (otInstance *)aContext;
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = otThreadGetDeviceRole(instance);
+        // If role changed to any of active roles then connect to known gateway or schedule SEARCHGW message
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_ROUTER)
+            && otMqttsnGetState(instance) == kStateDisconnected)
+        {
+            if (sGatewayKnown)
+            {
+                MqttsnConnect(instance);
+            }
+            else
+            {
+                ScheduleSearch();
+            }
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    otExtendedPanId extendedPanid;
+    otMasterKey masterKey;
+    otInstance *instance;
+
+    otSysInit(aArgc, aArgv);
+    instance = otInstanceInitSingle();
+
+    // Set default network settings
+    // Set network name
+    error = otThreadSetNetworkName(instance, NETWORK_NAME);
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    error = otThreadSetExtendedPanId(instance, &extendedPanid);
+    // Set PANID
+    error = otLinkSetPanId(instance, PANID);
+    // Set channel
+    error = otLinkSetChannel(instance, DEFAULT_CHANNEL);
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    error = otThreadSetMasterKey(instance, &masterKey);
+
+    // Register notifier callback to receive thread role changed events
+    error = otSetStateChangedCallback(instance, StateChanged, instance);
+
+    // Start thread network
+    otIp6SetSlaacEnabled(instance, true);
+    error = otIp6SetEnabled(instance, true);
+    error = otThreadSetEnabled(instance, true);
+
+    // Start MQTT-SN client
+    error = otMqttsnStart(instance, CLIENT_PORT);
+    // Listen for ADVERTISE and GWINFO messages all the time
+    otMqttsnSetSearchgwHandler(instance, HandleSearchGw, (void *)instance);
+    otMqttsnSetAdvertiseHandler(instance, HandleAdvertise, (void *)instance);
+
+    while (true)
+    {
+        otTaskletsProcess(instance);
+        otSysProcessDrivers(instance);
+        // Send delayed SEARCHGW when no gateway was discovered meanwhile, difference is wraparound safe
+        if (sSearchScheduled && (int32_t)(otPlatAlarmMilliGetNow() - sSearchAt) >= 0)
+        {
+            sSearchScheduled = false;
+            SearchGateway(instance);
+        }
+    }
+    return error;
+}
+
+void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
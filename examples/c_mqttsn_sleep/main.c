@@ -62,7 +62,8 @@
 static const uint8_t sExpanId[] = EXTPANID;
 static const uint8_t sMasterKey[] = MASTER_KEY;
 
-static uint32_t sNextAwakeAt = 0xffffffff;
+static bool sSleepCycleEnabled = false;
+static uint32_t sNextAwakeAt = 0;
 
 static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
 {
@@ -81,10 +82,16 @@ static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
     OT_UNUSED_VARIABLE(aContext);
     // Handle disconnect
 
-    if (aType == kDisconnectAsleep && sNextAwakeAt == 0xffffffff)
+    if (aType == kDisconnectAsleep && !sSleepCycleEnabled)
     {
         // Handle asleep event
         sNextAwakeAt = otPlatAlarmMilliGetNow() + SLEEP_DURATION_MS;
+        sSleepCycleEnabled = true;
+    }
+    else if (aType != kDisconnectAsleep)
+    {
+        // Client is disconnected, stop awaking
+        sSleepCycleEnabled = false;
     }
 }
 
@@ -193,8 +200,8 @@ int main(int aArgc, char *aArgv[])
     {
         otTaskletsProcess(instance);
         otSysProcessDrivers(instance);
-        // Awake when scheduled time passed
-        if (otPlatAlarmMilliGetNow() > sNextAwakeAt)
+        // Awake when scheduled time passed, difference is safe against clock wraparound
+        if (sSleepCycleEnabled && (int32_t)(otPlatAlarmMilliGetNow() - sNextAwakeAt) >= 0)
         {
             otMqttsnAwake(instance, AWAKE_TIMEOUT_MS);
             sNextAwakeAt += SLEEP_DURATION_MS;
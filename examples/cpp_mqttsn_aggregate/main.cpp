@@ -0,0 +1,458 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Samples are taken every second and one summary per topic is published every window
+#define SAMPLE_INTERVAL_MS 1000
+#define WINDOW_DURATION_MS 60000
+// Sleep duration reported to the gateway is extended because of crystal precision deviation
+#define SLEEP_DURATION_MARGIN_MS 5000
+#define PAYLOAD_MAX_LENGTH 96
+// Summary publish is repeated this many times in one window when it is not acknowledged
+#define SUMMARY_MAX_ATTEMPTS 3
+
+using namespace ot::Mqttsn;
+
+// Statistics included in summary record
+enum
+{
+    kStatMin = 1 << 0,
+    kStatMax = 1 << 1,
+    kStatAvg = 1 << 2,
+    kStatCount = 1 << 3
+};
+
+struct AggregatorConfig
+{
+    const char *mTopicName;
+    uint8_t mStatistics;
+};
+
+struct Aggregator
+{
+    otMqttsnTopic mTopic;
+    bool mIsRegistered;
+    bool mIsRegistering;
+    // Statistics of current window
+    float mMin;
+    float mMax;
+    float mSum;
+    uint16_t mCount;
+    // Summary of closed window waiting for transmission
+    bool mHasSummary;
+    bool mIsSending;
+    uint8_t mAttempts;
+    char mSummary[PAYLOAD_MAX_LENGTH];
+    int32_t mSummaryLength;
+};
+
+static const AggregatorConfig sAggregatorConfigs[] = {
+    { "sensors/temperature", kStatMin | kStatMax | kStatAvg },
+    { "sensors/humidity", kStatAvg | kStatCount }
+};
+
+#define AGGREGATOR_COUNT (sizeof(sAggregatorConfigs) / sizeof(sAggregatorConfigs[0]))
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static Aggregator sAggregators[AGGREGATOR_COUNT];
+static ot::TimerMilli* sSampleTimer = NULL;
+static ot::TimerMilli* sWindowTimer = NULL;
+static bool sSleepRequested = false;
+static bool sHasSession = false;
+static uint32_t sSampleCount = 0;
+static uint32_t sPublishCount = 0;
+
+static void AggregatorPush(Aggregator &aAggregator, float aValue)
+{
+    if (aAggregator.mCount == 0 || aValue < aAggregator.mMin)
+    {
+        aAggregator.mMin = aValue;
+    }
+    if (aAggregator.mCount == 0 || aValue > aAggregator.mMax)
+    {
+        aAggregator.mMax = aValue;
+    }
+    aAggregator.mSum += aValue;
+    aAggregator.mCount++;
+    sSampleCount++;
+}
+
+static int AppendStatistic(char *aBuffer, int aOffset, const char *aName, float aValue, int aPrecision)
+{
+    if (aOffset < 0 || aOffset >= PAYLOAD_MAX_LENGTH)
+    {
+        return -1;
+    }
+    return aOffset + snprintf(aBuffer + aOffset, PAYLOAD_MAX_LENGTH - aOffset, "%s\"%s\":%.*f",
+        aOffset > 1 ? "," : "", aName, aPrecision, aValue);
+}
+
+// Turn statistics of finished window to summary record and start new window
+static void AggregatorCloseWindow(Aggregator &aAggregator, uint8_t aStatistics)
+{
+    char *summary = aAggregator.mSummary;
+    int length = 1;
+
+    // Previous summary is still in flight, window is extended until it is acknowledged
+    if (aAggregator.mCount == 0 || aAggregator.mIsSending)
+    {
+        return;
+    }
+    summary[0] = '{';
+    if (aStatistics & kStatMin)
+    {
+        length = AppendStatistic(summary, length, "min", aAggregator.mMin, 2);
+    }
+    if (aStatistics & kStatMax)
+    {
+        length = AppendStatistic(summary, length, "max", aAggregator.mMax, 2);
+    }
+    if (aStatistics & kStatAvg)
+    {
+        length = AppendStatistic(summary, length, "avg", aAggregator.mSum / aAggregator.mCount, 2);
+    }
+    if (aStatistics & kStatCount)
+    {
+        length = AppendStatistic(summary, length, "count", aAggregator.mCount, 0);
+    }
+    if (length > 0 && length < PAYLOAD_MAX_LENGTH - 1)
+    {
+        summary[length++] = '}';
+        // Summary which was not sent yet is replaced by the newer one
+        aAggregator.mHasSummary = true;
+        aAggregator.mSummaryLength = length;
+    }
+    aAggregator.mCount = 0;
+    aAggregator.mSum = 0;
+}
+
+static void TrySleep()
+{
+    if (!sSleepRequested || sClient->GetState() != kStateActive)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < AGGREGATOR_COUNT; i++)
+    {
+        if (sAggregators[i].mHasSummary && sAggregators[i].mAttempts < SUMMARY_MAX_ATTEMPTS)
+        {
+            // Summaries must be delivered before radio goes to sleep, the ones which
+            // failed in all attempts are sent again in next window
+            return;
+        }
+    }
+    // Window timer wakes the client when next summaries are ready
+    if (sClient->Sleep((WINDOW_DURATION_MS + SLEEP_DURATION_MARGIN_MS) / 1000) == OT_ERROR_NONE)
+    {
+        sSleepRequested = false;
+    }
+}
+
+// Publish pending summaries and go to sleep when all of them are acknowledged
+static void FlushAndSleep()
+{
+    sSleepRequested = true;
+    TrySleep();
+}
+
+static void SendSummaries();
+
+static void HandleSummaryPublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    Aggregator &aggregator = *static_cast<Aggregator *>(aContext);
+    // Handle published
+
+    aggregator.mIsSending = false;
+    if (aCode == kCodeAccepted)
+    {
+        aggregator.mHasSummary = false;
+        TrySleep();
+    }
+    else if (aCode == kCodeRejectedTopicId)
+    {
+        // Gateway did not keep topic registration during sleep
+        aggregator.mIsRegistered = false;
+        sHasSession = false;
+        SendSummaries();
+    }
+    else if (aggregator.mAttempts < SUMMARY_MAX_ATTEMPTS)
+    {
+        // Publish timed out or gateway is congested, send summary again
+        SendSummaries();
+    }
+    else
+    {
+        TrySleep();
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    Aggregator &aggregator = *static_cast<Aggregator *>(aContext);
+    // Handle registered
+
+    aggregator.mIsRegistering = false;
+    if (aCode == kCodeAccepted)
+    {
+        aggregator.mTopic = *aTopic;
+        aggregator.mIsRegistered = true;
+        SendSummaries();
+    }
+}
+
+static void SendSummaries()
+{
+    if (sClient->GetState() != kStateActive)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < AGGREGATOR_COUNT; i++)
+    {
+        Aggregator &aggregator = sAggregators[i];
+        if (!aggregator.mIsRegistered)
+        {
+            // Register only once, this is called again after every REGACK and PUBACK
+            if (!aggregator.mIsRegistering
+                && sClient->Register(sAggregatorConfigs[i].mTopicName, HandleRegistered, &aggregator) == OT_ERROR_NONE)
+            {
+                aggregator.mIsRegistering = true;
+            }
+            continue;
+        }
+        if (!aggregator.mHasSummary || aggregator.mIsSending || aggregator.mAttempts >= SUMMARY_MAX_ATTEMPTS)
+        {
+            continue;
+        }
+        if (sClient->Publish(reinterpret_cast<const uint8_t *>(aggregator.mSummary), aggregator.mSummaryLength,
+            kQos1, false, *static_cast<const Topic *>(&aggregator.mTopic), HandleSummaryPublished,
+            &aggregator) == OT_ERROR_NONE)
+        {
+            aggregator.mIsSending = true;
+            aggregator.mAttempts++;
+            sPublishCount++;
+        }
+    }
+}
+
+static void HandleSampleTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    // Sampling continues while radio sleeps
+    AggregatorPush(sAggregators[0], 24.0f);
+    AggregatorPush(sAggregators[1], 45.2f);
+    sSampleTimer->StartAt(sSampleTimer->GetFireTime(), SAMPLE_INTERVAL_MS);
+}
+
+static void MqttsnConnect();
+
+static void HandleWindowTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    for (uint8_t i = 0; i < AGGREGATOR_COUNT; i++)
+    {
+        AggregatorCloseWindow(sAggregators[i], sAggregatorConfigs[i].mStatistics);
+        // Every window gives pending summary new attempts
+        if (!sAggregators[i].mIsSending)
+        {
+            sAggregators[i].mAttempts = 0;
+        }
+    }
+    sWindowTimer->StartAt(sWindowTimer->GetFireTime(), WINDOW_DURATION_MS);
+    if (sClient->GetState() == kStateAsleep || sClient->GetState() == kStateDisconnected)
+    {
+        // Sleeping or disconnected client must connect again to publish
+        MqttsnConnect();
+    }
+    else
+    {
+        SendSummaries();
+        FlushAndSleep();
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sHasSession = true;
+        SendSummaries();
+        FlushAndSleep();
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    if (aType != kDisconnectAsleep)
+    {
+        // Session is lost, topics are registered again after next connect
+        sHasSession = false;
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    if (!sHasSession)
+    {
+        for (uint8_t i = 0; i < AGGREGATOR_COUNT; i++)
+        {
+            sAggregators[i].mIsRegistered = false;
+            sAggregators[i].mIsRegistering = false;
+        }
+    }
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    // Keep registrations when waking up from sleep
+    config.SetCleanSession(!sHasSession);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli sampleTimer(instance, HandleSampleTimer, NULL);
+    ot::TimerMilli windowTimer(instance, HandleWindowTimer, NULL);
+    sSampleTimer = &sampleTimer;
+    sWindowTimer = &windowTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+    sampleTimer.Start(SAMPLE_INTERVAL_MS);
+    windowTimer.Start(WINDOW_DURATION_MS);
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,430 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_MULTICAST_PORT 10000
+#define GATEWAY_MULTICAST_ADDRESS "ff03::2"
+#define GATEWAY_MULTICAST_RADIUS 8
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Maximal number of known gateways
+#define GATEWAY_TABLE_SIZE 4
+// Time for collecting GWINFO responses before the best gateway is selected
+#define GATEWAY_SEARCH_WINDOW_MS 3000
+// Gateway is skipped after this number of consecutive failures until it answers SEARCHGW again
+#define GATEWAY_MAX_FAILURES 2
+// Delay of repeated search when no usable gateway is known, doubled after every search
+#define GATEWAY_SEARCH_BACKOFF_MIN_MS 5000
+#define GATEWAY_SEARCH_BACKOFF_MAX_MS 300000
+// Delay before connecting again when client could not send CONNECT message
+#define GATEWAY_CONNECT_RETRY_MS 1000
+
+#define TOPIC_NAME "sensors"
+#define CONTROL_TOPIC_NAME "control"
+
+using namespace ot::Mqttsn;
+
+// Gateway discovered by GWINFO or ADVERTISE message
+struct GatewayEntry
+{
+    bool mIsUsed;
+    uint8_t mGatewayId;
+    ot::Ip6::Address mAddress;
+    uint32_t mLastSeen;
+    // Smoothed round-trip time in ms, zero until first sample
+    uint32_t mRtt;
+    uint8_t mFailures;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static GatewayEntry sGateways[GATEWAY_TABLE_SIZE];
+static GatewayEntry* sCurrentGateway = NULL;
+static ot::TimerMilli* sSearchTimer = NULL;
+static ot::TimerMilli* sConnectTimer = NULL;
+// Search timer measures search window while search is in progress, otherwise backoff delay
+static bool sSearchInProgress = false;
+static uint32_t sSearchBackoff = GATEWAY_SEARCH_BACKOFF_MIN_MS;
+static uint32_t sSearchStartedAt = 0;
+static uint32_t sConnectStartedAt = 0;
+static otMqttsnTopic sTopic;
+
+static void SearchGateway();
+static void ConnectBestGateway();
+
+// Client is not connected when disconnected or when connection was lost by keepalive timeout
+static bool IsClientDisconnected()
+{
+    ClientState state = sClient->GetState();
+    return state != kStateActive && state != kStateAsleep && state != kStateAwake;
+}
+
+static void GatewayAddRttSample(GatewayEntry &aGateway, uint32_t aRtt)
+{
+    // Exponentially weighted average with 1/4 weight of the new sample
+    aGateway.mRtt = aGateway.mRtt == 0 ? aRtt : aGateway.mRtt - (aGateway.mRtt >> 2) + (aRtt >> 2);
+}
+
+static GatewayEntry *GatewayUpdate(const ot::Ip6::Address &aAddress, uint8_t aGatewayId)
+{
+    GatewayEntry *entry = NULL;
+    GatewayEntry *victim = NULL;
+
+    for (uint8_t i = 0; i < GATEWAY_TABLE_SIZE; i++)
+    {
+        GatewayEntry &gateway = sGateways[i];
+        if (gateway.mIsUsed && gateway.mGatewayId == aGatewayId && gateway.mAddress == aAddress)
+        {
+            entry = &gateway;
+            break;
+        }
+        if (&gateway == sCurrentGateway || (victim != NULL && !victim->mIsUsed))
+        {
+            continue;
+        }
+        // Prefer free entry, otherwise the least recently seen one
+        if (victim == NULL || !gateway.mIsUsed
+            || static_cast<int32_t>(gateway.mLastSeen - victim->mLastSeen) < 0)
+        {
+            victim = &gateway;
+        }
+    }
+    if (entry == NULL && victim != NULL)
+    {
+        entry = victim;
+        memset(entry, 0, sizeof(*entry));
+        entry->mIsUsed = true;
+        entry->mGatewayId = aGatewayId;
+        entry->mAddress = aAddress;
+    }
+    if (entry != NULL)
+    {
+        entry->mLastSeen = ot::TimerMilli::GetNow().GetValue();
+    }
+    return entry;
+}
+
+// Select reachable gateway with the fewest recent failures and then with the lowest
+// round-trip time, gateways without RTT sample are used only when there is no measured one
+static GatewayEntry *GatewaySelectBest()
+{
+    GatewayEntry *best = NULL;
+
+    for (uint8_t i = 0; i < GATEWAY_TABLE_SIZE; i++)
+    {
+        GatewayEntry &gateway = sGateways[i];
+        if (!gateway.mIsUsed || gateway.mFailures >= GATEWAY_MAX_FAILURES)
+        {
+            continue;
+        }
+        if (best == NULL || gateway.mFailures < best->mFailures
+            || (gateway.mFailures == best->mFailures && gateway.mRtt != 0
+                && (best->mRtt == 0 || gateway.mRtt < best->mRtt)))
+        {
+            best = &gateway;
+        }
+    }
+    return best;
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from control topic
+
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Topic ID is valid only for current gateway
+        sTopic = *aTopic;
+    }
+}
+
+static void HandleConnected(ReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (sCurrentGateway == NULL)
+    {
+        return;
+    }
+    if (aCode == kCodeAccepted)
+    {
+        GatewayAddRttSample(*sCurrentGateway, ot::TimerMilli::GetNow().GetValue() - sConnectStartedAt);
+        sCurrentGateway->mFailures = 0;
+        sSearchBackoff = GATEWAY_SEARCH_BACKOFF_MIN_MS;
+        // Registrations and subscriptions are bound to the gateway session,
+        // establish them again after every (re)connect
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+        sClient->Subscribe(Topic::FromTopicName(CONTROL_TOPIC_NAME), kQos1, HandleSubscribed, NULL);
+    }
+    else
+    {
+        // Gateway rejected connection or did not respond, try next one
+        sCurrentGateway->mFailures++;
+        ConnectBestGateway();
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    if (aType == kDisconnectTimeout && sCurrentGateway != NULL)
+    {
+        // Keepalive or retransmissions timed out, fail over to next gateway
+        sCurrentGateway->mFailures++;
+        ConnectBestGateway();
+    }
+}
+
+static void ScheduleSearch()
+{
+    // All known gateways failed, search again later so dead network is not flooded with SEARCHGW
+    sSearchInProgress = false;
+    sSearchTimer->Start(sSearchBackoff);
+    sSearchBackoff = 2 * sSearchBackoff < GATEWAY_SEARCH_BACKOFF_MAX_MS ? 2 * sSearchBackoff
+        : GATEWAY_SEARCH_BACKOFF_MAX_MS;
+}
+
+static void ConnectBestGateway()
+{
+    MqttsnConfig config;
+
+    sCurrentGateway = GatewaySelectBest();
+    if (sCurrentGateway == NULL)
+    {
+        // No usable gateway is known, search again
+        ScheduleSearch();
+        return;
+    }
+
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_MULTICAST_PORT);
+    config.SetAddress(sCurrentGateway->mAddress);
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    sConnectStartedAt = ot::TimerMilli::GetNow().GetValue();
+    if (sClient->Connect(config) != OT_ERROR_NONE)
+    {
+        // CONNECT message was not sent, no callback will come so try again later
+        sConnectTimer->Start(GATEWAY_CONNECT_RETRY_MS);
+    }
+}
+
+static void HandleConnectTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    if (IsClientDisconnected())
+    {
+        ConnectBestGateway();
+    }
+}
+
+static void HandleSearchGw(const otIp6Address* aAddress, uint8_t aGatewayId, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle SEARCHGW response received
+    // Remember gateway and use response delay as first RTT estimate
+    GatewayEntry *gateway = GatewayUpdate(*static_cast<const ot::Ip6::Address *>(aAddress), aGatewayId);
+
+    if (gateway != NULL && sSearchInProgress)
+    {
+        GatewayAddRttSample(*gateway, ot::TimerMilli::GetNow().GetValue() - sSearchStartedAt);
+        // Failed gateway answered our search, it gets one more attempt with the lowest preference
+        if (gateway->mFailures >= GATEWAY_MAX_FAILURES)
+        {
+            gateway->mFailures = GATEWAY_MAX_FAILURES - 1;
+        }
+    }
+}
+
+static void HandleAdvertise(const otIp6Address* aAddress, uint8_t aGatewayId, uint32_t aDuration, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aDuration);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle ADVERTISE message received
+    // Gateway is reachable, no RTT sample is available from broadcast
+    GatewayUpdate(*static_cast<const ot::Ip6::Address *>(aAddress), aGatewayId);
+}
+
+static void HandleSearchTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    if (!sSearchInProgress)
+    {
+        // Backoff delay passed, search again
+        SearchGateway();
+        return;
+    }
+    // Search window passed, connect to the best of responding gateways
+    sSearchInProgress = false;
+    if (IsClientDisconnected())
+    {
+        ConnectBestGateway();
+    }
+}
+
+static void SearchGateway()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_MULTICAST_ADDRESS);
+
+    // Failure counts are kept, gateways which failed are preferred less than the others
+    sClient->SetSearchGwCallback(HandleSearchGw, NULL);
+    sClient->SetAdvertiseCallback(HandleAdvertise, NULL);
+    // Send SEARCHGW multicast message and collect responses
+    sSearchStartedAt = ot::TimerMilli::GetNow().GetValue();
+    sSearchInProgress = true;
+    sSearchTimer->Start(GATEWAY_SEARCH_WINDOW_MS);
+    sClient->SearchGateway(address, GATEWAY_MULTICAST_PORT, GATEWAY_MULTICAST_RADIUS);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles then send SEARCHGW message
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && IsClientDisconnected())
+        {
+            SearchGateway();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli searchTimer(instance, HandleSearchTimer, NULL);
+    sSearchTimer = &searchTimer;
+    ot::TimerMilli connectTimer(instance, HandleConnectTimer, NULL);
+    sConnectTimer = &connectTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
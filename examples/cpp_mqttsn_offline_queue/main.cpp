@@ -0,0 +1,503 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread/platform/settings.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+#define PUBLISH_INTERVAL_MS 10000
+
+// Settings keys from 0x8000 are not used by OpenThread core and are free for application data.
+// Every queue slot has its own key so writes rotate over all records and no
+// shared header record is rewritten with every message.
+#define SETTINGS_KEY_QUEUE_BASE 0x8010
+#define QUEUE_CAPACITY 16
+#define QUEUE_RECORD_PAYLOAD_SIZE 40
+// Number of queued messages sent at once after connect
+#define QUEUE_DRAIN_BATCH_SIZE 4
+// Pause between drained batches to not congest gateway and the mesh
+#define QUEUE_DRAIN_INTERVAL_MS 500
+
+using namespace ot::Mqttsn;
+
+// What to do when message is queued to full queue
+enum QueueDropPolicy
+{
+    kQueueDropOldest,
+    kQueueDropNewest
+};
+
+// Fixed size record stored in settings
+struct QueueRecord
+{
+    uint32_t mSequence;
+    uint8_t mLength;
+    uint8_t mData[QUEUE_RECORD_PAYLOAD_SIZE];
+};
+
+struct QueueSlot
+{
+    bool mIsUsed;
+    bool mIsSent;
+};
+
+struct QueueMetrics
+{
+    uint16_t mOccupancy;
+    uint16_t mHighWatermark;
+    uint32_t mEnqueuedCount;
+    uint32_t mDeliveredCount;
+    uint32_t mDroppedCount;
+};
+
+static MqttsnClient* sClient = NULL;
+static otInstance* sInstance = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static const QueueDropPolicy sQueueDropPolicy = kQueueDropOldest;
+// Queue holds sequences from head to tail, record with sequence N is stored in slot N % QUEUE_CAPACITY
+static QueueSlot sQueueSlots[QUEUE_CAPACITY];
+static uint32_t sQueueHead = 0;
+static uint32_t sQueueTail = 0;
+static uint8_t sQueueInFlight = 0;
+static QueueMetrics sQueueMetrics;
+static ot::TimerMilli* sDrainTimer = NULL;
+static ot::TimerMilli* sPublishTimer = NULL;
+static otMqttsnTopic sTopic;
+static bool sTopicRegistered = false;
+static uint16_t sReadingSequence = 0;
+// Message published directly while client is online is kept only in RAM and
+// written to settings when it is not acknowledged, so flash is written only
+// for messages which really wait for delivery
+static QueueRecord sLiveRecord;
+static bool sLiveInFlight = false;
+static uint32_t sLiveSequence = 0;
+
+static QueueSlot &QueueGetSlot(uint32_t aSequence)
+{
+    return sQueueSlots[aSequence % QUEUE_CAPACITY];
+}
+
+static void QueueLoad()
+{
+    bool isEmpty = true;
+
+    // Restore head and tail from sequence numbers of stored records
+    for (uint16_t i = 0; i < QUEUE_CAPACITY; i++)
+    {
+        QueueRecord record;
+        uint16_t length = sizeof(record);
+        if (otPlatSettingsGet(sInstance, SETTINGS_KEY_QUEUE_BASE + i, 0,
+                reinterpret_cast<uint8_t *>(&record), &length) != OT_ERROR_NONE
+            || length != sizeof(record) || record.mSequence % QUEUE_CAPACITY != i)
+        {
+            continue;
+        }
+        sQueueSlots[i].mIsUsed = true;
+        sQueueMetrics.mOccupancy++;
+        if (isEmpty || static_cast<int32_t>(record.mSequence - sQueueHead) < 0)
+        {
+            sQueueHead = record.mSequence;
+        }
+        if (isEmpty || static_cast<int32_t>(record.mSequence + 1 - sQueueTail) > 0)
+        {
+            sQueueTail = record.mSequence + 1;
+        }
+        isEmpty = false;
+    }
+    sQueueMetrics.mHighWatermark = sQueueMetrics.mOccupancy;
+}
+
+static void QueueRemove(uint32_t aSequence)
+{
+    QueueSlot &slot = QueueGetSlot(aSequence);
+
+    otPlatSettingsDelete(sInstance, SETTINGS_KEY_QUEUE_BASE + aSequence % QUEUE_CAPACITY, 0);
+    slot.mIsUsed = false;
+    slot.mIsSent = false;
+    sQueueMetrics.mOccupancy--;
+    // Skip records acknowledged out of order
+    while (sQueueHead != sQueueTail && !QueueGetSlot(sQueueHead).mIsUsed)
+    {
+        sQueueHead++;
+    }
+}
+
+static otError QueuePush(const uint8_t *aData, uint8_t aLength)
+{
+    QueueRecord record;
+    otError error;
+
+    if (aLength > QUEUE_RECORD_PAYLOAD_SIZE)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    if (sQueueTail - sQueueHead == QUEUE_CAPACITY)
+    {
+        sQueueMetrics.mDroppedCount++;
+        if (sQueueDropPolicy == kQueueDropNewest)
+        {
+            return OT_ERROR_NO_BUFS;
+        }
+        // Make space by dropping the oldest message, its slot is reused by new one
+        QueueRemove(sQueueHead);
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.mSequence = sQueueTail;
+    record.mLength = aLength;
+    memcpy(record.mData, aData, aLength);
+    error = otPlatSettingsSet(sInstance, SETTINGS_KEY_QUEUE_BASE + sQueueTail % QUEUE_CAPACITY,
+        reinterpret_cast<const uint8_t *>(&record), sizeof(record));
+    if (error != OT_ERROR_NONE)
+    {
+        return error;
+    }
+    QueueGetSlot(sQueueTail).mIsUsed = true;
+    sQueueTail++;
+    sQueueMetrics.mEnqueuedCount++;
+    sQueueMetrics.mOccupancy++;
+    if (sQueueMetrics.mOccupancy > sQueueMetrics.mHighWatermark)
+    {
+        sQueueMetrics.mHighWatermark = sQueueMetrics.mOccupancy;
+    }
+    return OT_ERROR_NONE;
+}
+
+static void QueueDrain();
+
+static void HandleQueuePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Record sequence number is passed as context, record may be dropped meanwhile
+    uint32_t sequence = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(aContext));
+    // Handle published
+
+    if (sQueueInFlight > 0)
+    {
+        sQueueInFlight--;
+    }
+    if (static_cast<int32_t>(sequence - sQueueHead) >= 0 && static_cast<int32_t>(sequence - sQueueTail) < 0
+        && QueueGetSlot(sequence).mIsUsed)
+    {
+        if (aCode == kCodeAccepted)
+        {
+            sQueueMetrics.mDeliveredCount++;
+            QueueRemove(sequence);
+        }
+        else
+        {
+            // Keep record and send it in some of next batches
+            QueueGetSlot(sequence).mIsSent = false;
+        }
+    }
+    if (sQueueInFlight == 0)
+    {
+        // Whole batch finished, continue after pause
+        sDrainTimer->Start(QUEUE_DRAIN_INTERVAL_MS);
+    }
+}
+
+static void QueueDrain()
+{
+    if (sClient->GetState() != kStateActive || !sTopicRegistered || sQueueInFlight > 0)
+    {
+        return;
+    }
+    // Send next batch in the order messages were queued
+    for (uint32_t sequence = sQueueHead; sequence != sQueueTail && sQueueInFlight < QUEUE_DRAIN_BATCH_SIZE; sequence++)
+    {
+        QueueSlot &slot = QueueGetSlot(sequence);
+        QueueRecord record;
+        uint16_t length = sizeof(record);
+
+        if (!slot.mIsUsed || slot.mIsSent)
+        {
+            continue;
+        }
+        if (otPlatSettingsGet(sInstance, SETTINGS_KEY_QUEUE_BASE + sequence % QUEUE_CAPACITY, 0,
+                reinterpret_cast<uint8_t *>(&record), &length) != OT_ERROR_NONE
+            || length != sizeof(record) || record.mSequence != sequence)
+        {
+            // Record is corrupted, remove it so it does not block the queue
+            QueueRemove(sequence);
+            continue;
+        }
+        if (sClient->Publish(record.mData, record.mLength, kQos1, false, *static_cast<const Topic *>(&sTopic),
+            HandleQueuePublished, reinterpret_cast<void *>(static_cast<uintptr_t>(sequence))) != OT_ERROR_NONE)
+        {
+            break;
+        }
+        slot.mIsSent = true;
+        sQueueInFlight++;
+    }
+}
+
+static void LivePersist()
+{
+    // Unacknowledged message is stored and delivered with queued ones
+    sLiveInFlight = false;
+    QueuePush(sLiveRecord.mData, sLiveRecord.mLength);
+}
+
+static void HandleLivePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Live message sequence is passed as context so late result of persisted message is ignored
+    uint32_t sequence = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(aContext));
+    // Handle published
+
+    if (!sLiveInFlight || sequence != sLiveSequence)
+    {
+        return;
+    }
+    if (aCode == kCodeAccepted)
+    {
+        sLiveInFlight = false;
+        sQueueMetrics.mDeliveredCount++;
+    }
+    else
+    {
+        LivePersist();
+        QueueDrain();
+    }
+}
+
+static otError PublishLive(const uint8_t *aData, uint8_t aLength)
+{
+    otError error;
+
+    // Publish directly only when nothing is queued so messages are delivered in order
+    if (sClient->GetState() != kStateActive || !sTopicRegistered || sQueueHead != sQueueTail || sLiveInFlight
+        || aLength > QUEUE_RECORD_PAYLOAD_SIZE)
+    {
+        return OT_ERROR_INVALID_STATE;
+    }
+    sLiveSequence++;
+    error = sClient->Publish(aData, aLength, kQos1, false, *static_cast<const Topic *>(&sTopic),
+        HandleLivePublished, reinterpret_cast<void *>(static_cast<uintptr_t>(sLiveSequence)));
+    if (error == OT_ERROR_NONE)
+    {
+        sLiveRecord.mLength = aLength;
+        memcpy(sLiveRecord.mData, aData, aLength);
+        sLiveInFlight = true;
+    }
+    return error;
+}
+
+static void HandleDrainTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    QueueDrain();
+}
+
+static void HandlePublishTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    char data[QUEUE_RECORD_PAYLOAD_SIZE];
+    int32_t length = snprintf(data, sizeof(data), "{\"seq\":%u,\"temperature\":24.0}",
+        static_cast<unsigned int>(sReadingSequence++));
+
+    // Reading is published directly when client is online, it is stored so it
+    // survives reset only when client is offline or older messages are queued
+    if (PublishLive(reinterpret_cast<const uint8_t *>(data), static_cast<uint8_t>(length)) != OT_ERROR_NONE
+        && QueuePush(reinterpret_cast<const uint8_t *>(data), static_cast<uint8_t>(length)) == OT_ERROR_NONE)
+    {
+        QueueDrain();
+    }
+    sPublishTimer->StartAt(sPublishTimer->GetFireTime(), PUBLISH_INTERVAL_MS);
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        sTopic = *aTopic;
+        sTopicRegistered = true;
+        // Send messages queued while disconnected
+        QueueDrain();
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    // Unacknowledged records stay in queue and are sent again after reconnect
+    sTopicRegistered = false;
+    if (sLiveInFlight)
+    {
+        LivePersist();
+    }
+    sQueueInFlight = 0;
+    sDrainTimer->Stop();
+    for (uint16_t i = 0; i < QUEUE_CAPACITY; i++)
+    {
+        sQueueSlots[i].mIsSent = false;
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli drainTimer(instance, HandleDrainTimer, NULL);
+    ot::TimerMilli publishTimer(instance, HandlePublishTimer, NULL);
+    sInstance = &instance;
+    sDrainTimer = &drainTimer;
+    sPublishTimer = &publishTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+    // Restore messages which were not delivered before reset
+    QueueLoad();
+    publishTimer.Start(PUBLISH_INTERVAL_MS);
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
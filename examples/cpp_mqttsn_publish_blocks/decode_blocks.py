@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2018, Vit Holasek
+#  All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are met:
+#  1. Redistributions of source code must retain the above copyright
+#     notice, this list of conditions and the following disclaimer.
+#  2. Redistributions in binary form must reproduce the above copyright
+#     notice, this list of conditions and the following disclaimer in the
+#     documentation and/or other materials provided with the distribution.
+#  3. Neither the name of the copyright holder nor the
+#     names of its contributors may be used to endorse or promote products
+#     derived from this software without specific prior written permission.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+#  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+#  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+#  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+#  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+#  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+#  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+#  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+#  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+#  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+#  POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Reassemble block transfers published by the example on the MQTT broker side
+# and write every complete transfer to stdout. Requires paho-mqtt package.
+#
+# Usage: decode_blocks.py <mqtt-broker> [topic]
+
+import struct
+import sys
+
+import paho.mqtt.client as mqtt
+
+BLOCK_HEADER_SIZE = 5
+BLOCK_PAYLOAD_SIZE = 48
+
+# Incomplete transfers by (topic, transfer ID)
+transfers = {}
+
+
+def on_message(client, userdata, message):
+    payload = message.payload
+    if len(payload) < BLOCK_HEADER_SIZE:
+        return
+    transfer_id, index, count = struct.unpack('>BHH', payload[:BLOCK_HEADER_SIZE])
+    if count == 0 or index >= count:
+        return
+    key = (message.topic, transfer_id)
+    blocks = transfers.get(key)
+    if blocks is None or len(blocks) != count:
+        # New transfer replaces the incomplete one with the same ID
+        blocks = [None] * count
+        transfers[key] = blocks
+    blocks[index] = payload[BLOCK_HEADER_SIZE:]
+    if all(block is not None for block in blocks):
+        del transfers[key]
+        sys.stdout.buffer.write(b''.join(blocks))
+        sys.stdout.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: decode_blocks.py <mqtt-broker> [topic]', file=sys.stderr)
+        return 1
+    topic = sys.argv[2] if len(sys.argv) > 2 else 'logs'
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(sys.argv[1], 1883)
+    client.subscribe(topic, qos=1)
+    client.loop_forever()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
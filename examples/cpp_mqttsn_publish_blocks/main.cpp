@@ -0,0 +1,514 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define LOG_TOPIC_NAME "logs"
+#define CONFIG_TOPIC_NAME "config"
+
+// Every block is published as separate message with header:
+// transfer ID (1 byte), block index (2 bytes) and block count (2 bytes), big endian
+#define BLOCK_HEADER_SIZE 5
+// Block payload size chosen so whole PUBLISH fits into single 802.15.4 frame
+#define BLOCK_PAYLOAD_SIZE 48
+#define BLOCK_MAX_COUNT 64
+// Maximal number of blocks waiting for PUBACK at the same time
+#define BLOCK_WINDOW_SIZE 4
+#define BLOCK_MAX_ATTEMPTS 3
+// Delay before sending is retried when no block could be sent and none is waiting for PUBACK
+#define BLOCK_RETRY_DELAY_MS 1000
+// Transfer fails when sending is retried this many times in a row without success
+#define BLOCK_MAX_SEND_RETRIES 5
+#define CONFIG_BUFFER_SIZE 1024
+
+using namespace ot::Mqttsn;
+
+// Called when whole transfer is acknowledged or failed
+typedef void (*BlockTransferHandler)(otError aError, void *aContext);
+// Called with reassembled payload
+typedef void (*BlockSinkHandler)(const uint8_t *aData, uint16_t aLength, void *aContext);
+
+struct BlockTransfer
+{
+    bool mIsActive;
+    uint8_t mTransferId;
+    const uint8_t *mData;
+    uint16_t mLength;
+    uint16_t mBlockCount;
+    uint8_t mInFlight;
+    uint8_t mSendRetries;
+    otMqttsnTopic mTopic;
+    uint8_t mSent[BLOCK_MAX_COUNT / 8];
+    uint8_t mAcked[BLOCK_MAX_COUNT / 8];
+    uint8_t mAttempts[BLOCK_MAX_COUNT];
+    BlockTransferHandler mHandler;
+    void *mContext;
+};
+
+struct BlockReassembly
+{
+    uint8_t *mBuffer;
+    uint16_t mBufferSize;
+    bool mIsActive;
+    uint8_t mTransferId;
+    uint16_t mBlockCount;
+    uint16_t mReceivedCount;
+    uint16_t mLength;
+    uint8_t mReceived[BLOCK_MAX_COUNT / 8];
+    BlockSinkHandler mSink;
+    void *mContext;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static ot::TimerMilli* sRetryTimer = NULL;
+static BlockTransfer sTransfer;
+static uint8_t sNextTransferId = 0;
+static BlockReassembly sReassembly;
+static uint8_t sConfigBuffer[CONFIG_BUFFER_SIZE];
+static otMqttsnTopicId sConfigTopicId = 0;
+static char sLogBuffer[1500];
+
+static bool BitmapGet(const uint8_t *aBitmap, uint16_t aIndex)
+{
+    return (aBitmap[aIndex / 8] & (1 << (aIndex % 8))) != 0;
+}
+
+static void BitmapSet(uint8_t *aBitmap, uint16_t aIndex, bool aValue)
+{
+    if (aValue)
+    {
+        aBitmap[aIndex / 8] |= (1 << (aIndex % 8));
+    }
+    else
+    {
+        aBitmap[aIndex / 8] &= ~(1 << (aIndex % 8));
+    }
+}
+
+static void BlockTransferSend();
+
+static void BlockTransferFinish(otError aError)
+{
+    sTransfer.mIsActive = false;
+    sRetryTimer->Stop();
+    if (sTransfer.mHandler != NULL)
+    {
+        sTransfer.mHandler(aError, sTransfer.mContext);
+    }
+}
+
+static void HandleBlockPublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    // Transfer ID and block index are passed as context
+    uintptr_t context = reinterpret_cast<uintptr_t>(aContext);
+    uint8_t transferId = static_cast<uint8_t>(context >> 16);
+    uint16_t index = static_cast<uint16_t>(context & 0xffff);
+    // Handle published
+
+    if (!sTransfer.mIsActive || transferId != sTransfer.mTransferId)
+    {
+        return;
+    }
+    sTransfer.mInFlight--;
+    if (aCode == kCodeAccepted)
+    {
+        BitmapSet(sTransfer.mAcked, index, true);
+    }
+    else if (sTransfer.mAttempts[index] < BLOCK_MAX_ATTEMPTS)
+    {
+        // Selective retransmission, only the lost block is sent again
+        BitmapSet(sTransfer.mSent, index, false);
+    }
+    else
+    {
+        BlockTransferFinish(OT_ERROR_FAILED);
+        return;
+    }
+    BlockTransferSend();
+}
+
+static void BlockTransferSend()
+{
+    uint16_t ackedCount = 0;
+
+    for (uint16_t index = 0; index < sTransfer.mBlockCount; index++)
+    {
+        uint8_t block[BLOCK_HEADER_SIZE + BLOCK_PAYLOAD_SIZE];
+        uint16_t offset = index * BLOCK_PAYLOAD_SIZE;
+        uint16_t length = sTransfer.mLength - offset;
+        uintptr_t context = (static_cast<uintptr_t>(sTransfer.mTransferId) << 16) | index;
+
+        if (BitmapGet(sTransfer.mAcked, index))
+        {
+            ackedCount++;
+            continue;
+        }
+        if (BitmapGet(sTransfer.mSent, index) || sTransfer.mInFlight >= BLOCK_WINDOW_SIZE)
+        {
+            continue;
+        }
+        if (length > BLOCK_PAYLOAD_SIZE)
+        {
+            length = BLOCK_PAYLOAD_SIZE;
+        }
+        block[0] = sTransfer.mTransferId;
+        block[1] = static_cast<uint8_t>(index >> 8);
+        block[2] = static_cast<uint8_t>(index);
+        block[3] = static_cast<uint8_t>(sTransfer.mBlockCount >> 8);
+        block[4] = static_cast<uint8_t>(sTransfer.mBlockCount);
+        memcpy(block + BLOCK_HEADER_SIZE, sTransfer.mData + offset, length);
+        if (sClient->Publish(block, BLOCK_HEADER_SIZE + length, kQos1, false,
+            *static_cast<const Topic *>(&sTransfer.mTopic), HandleBlockPublished,
+            reinterpret_cast<void *>(context)) != OT_ERROR_NONE)
+        {
+            // Not enough buffers, continue when next PUBACK is received. There is
+            // no PUBACK to wait for when nothing is in flight so retry after a delay.
+            if (sTransfer.mInFlight == 0)
+            {
+                if (sTransfer.mSendRetries >= BLOCK_MAX_SEND_RETRIES)
+                {
+                    BlockTransferFinish(OT_ERROR_NO_BUFS);
+                    return;
+                }
+                sTransfer.mSendRetries++;
+                sRetryTimer->Start(BLOCK_RETRY_DELAY_MS);
+            }
+            break;
+        }
+        sTransfer.mSendRetries = 0;
+        sTransfer.mAttempts[index]++;
+        sTransfer.mInFlight++;
+        BitmapSet(sTransfer.mSent, index, true);
+    }
+    if (ackedCount == sTransfer.mBlockCount)
+    {
+        BlockTransferFinish(OT_ERROR_NONE);
+    }
+}
+
+static void HandleRetryTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    if (sTransfer.mIsActive)
+    {
+        BlockTransferSend();
+    }
+}
+
+// Publish payload larger than single message in blocks, data must stay valid until handler is called
+static otError PublishBlocks(const uint8_t *aData, uint16_t aLength, const otMqttsnTopic &aTopic,
+    BlockTransferHandler aHandler, void *aContext)
+{
+    uint16_t blockCount = (aLength + BLOCK_PAYLOAD_SIZE - 1) / BLOCK_PAYLOAD_SIZE;
+
+    if (sTransfer.mIsActive)
+    {
+        return OT_ERROR_BUSY;
+    }
+    if (blockCount == 0 || blockCount > BLOCK_MAX_COUNT)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    memset(&sTransfer, 0, sizeof(sTransfer));
+    sTransfer.mIsActive = true;
+    sTransfer.mTransferId = sNextTransferId++;
+    sTransfer.mData = aData;
+    sTransfer.mLength = aLength;
+    sTransfer.mBlockCount = blockCount;
+    sTransfer.mTopic = aTopic;
+    sTransfer.mHandler = aHandler;
+    sTransfer.mContext = aContext;
+    BlockTransferSend();
+    return OT_ERROR_NONE;
+}
+
+static void BlockReassemblyInit(uint8_t *aBuffer, uint16_t aBufferSize, BlockSinkHandler aSink, void *aContext)
+{
+    memset(&sReassembly, 0, sizeof(sReassembly));
+    sReassembly.mBuffer = aBuffer;
+    sReassembly.mBufferSize = aBufferSize;
+    sReassembly.mSink = aSink;
+    sReassembly.mContext = aContext;
+}
+
+static void BlockReassemblyReceive(const uint8_t *aBlock, int32_t aLength)
+{
+    uint8_t transferId;
+    uint16_t index;
+    uint16_t blockCount;
+    uint16_t offset;
+    uint16_t length;
+
+    if (aLength < BLOCK_HEADER_SIZE || aLength > BLOCK_HEADER_SIZE + BLOCK_PAYLOAD_SIZE)
+    {
+        return;
+    }
+    transferId = aBlock[0];
+    index = static_cast<uint16_t>((aBlock[1] << 8) | aBlock[2]);
+    blockCount = static_cast<uint16_t>((aBlock[3] << 8) | aBlock[4]);
+    offset = index * BLOCK_PAYLOAD_SIZE;
+    length = static_cast<uint16_t>(aLength - BLOCK_HEADER_SIZE);
+    if (blockCount == 0 || blockCount > BLOCK_MAX_COUNT || index >= blockCount
+        || offset + length > sReassembly.mBufferSize
+        || (index + 1 < blockCount && length != BLOCK_PAYLOAD_SIZE))
+    {
+        return;
+    }
+    if (!sReassembly.mIsActive || transferId != sReassembly.mTransferId || blockCount != sReassembly.mBlockCount)
+    {
+        // First block of new transfer, previous incomplete transfer is abandoned
+        sReassembly.mIsActive = true;
+        sReassembly.mTransferId = transferId;
+        sReassembly.mBlockCount = blockCount;
+        sReassembly.mReceivedCount = 0;
+        memset(sReassembly.mReceived, 0, sizeof(sReassembly.mReceived));
+    }
+    if (BitmapGet(sReassembly.mReceived, index))
+    {
+        // Duplicate caused by retransmission
+        return;
+    }
+    memcpy(sReassembly.mBuffer + offset, aBlock + BLOCK_HEADER_SIZE, length);
+    BitmapSet(sReassembly.mReceived, index, true);
+    sReassembly.mReceivedCount++;
+    if (index + 1 == blockCount)
+    {
+        sReassembly.mLength = offset + length;
+    }
+    if (sReassembly.mReceivedCount == blockCount)
+    {
+        sReassembly.mIsActive = false;
+        sReassembly.mSink(sReassembly.mBuffer, sReassembly.mLength, sReassembly.mContext);
+    }
+}
+
+static void HandleConfigReceived(const uint8_t *aData, uint16_t aLength, void *aContext)
+{
+    OT_UNUSED_VARIABLE(aData);
+    OT_UNUSED_VARIABLE(aLength);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle complete configuration blob
+}
+
+static void HandleLogUploaded(otError aError, void *aContext)
+{
+    OT_UNUSED_VARIABLE(aError);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle log dump delivered or failed
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from subscribed topic
+
+    if (aTopic->mType == kTopicId && aTopic->mData.mTopicId == sConfigTopicId)
+    {
+        BlockReassemblyReceive(aPayload, aPayloadLength);
+    }
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+
+    if (aCode == kCodeAccepted)
+    {
+        sConfigTopicId = aTopic->mData.mTopicId;
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Upload diagnostic log dump larger than single message
+        uint16_t length = 0;
+        for (uint16_t line = 0; sizeof(sLogBuffer) - length > 32; line++)
+        {
+            length += snprintf(sLogBuffer + length, sizeof(sLogBuffer) - length,
+                "%05u radio rssi=-72 lqi=255\n", static_cast<unsigned int>(line));
+        }
+        PublishBlocks(reinterpret_cast<const uint8_t *>(sLogBuffer), length, *aTopic, HandleLogUploaded, NULL);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        BlockReassemblyInit(sConfigBuffer, sizeof(sConfigBuffer), HandleConfigReceived, NULL);
+        sClient->Subscribe(Topic::FromTopicName(CONFIG_TOPIC_NAME), kQos1, HandleSubscribed, NULL);
+        sClient->Register(LOG_TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    if (sTransfer.mIsActive)
+    {
+        BlockTransferFinish(OT_ERROR_ABORT);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli retryTimer(instance, HandleRetryTimer, NULL);
+    sRetryTimer = &retryTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,406 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CBOR_HPP_
+#define CBOR_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+// Minimal allocation free CBOR (RFC 7049) encoder and decoder working on fixed
+// buffers. Only definite length items are supported which is enough for
+// sensor records encoded as maps with small integer keys.
+
+enum CborMajorType
+{
+    kCborUnsigned = 0,
+    kCborNegative = 1,
+    kCborBytes = 2,
+    kCborText = 3,
+    kCborArray = 4,
+    kCborMap = 5,
+    kCborTag = 6,
+    kCborSimple = 7
+};
+
+class CborWriter
+{
+public:
+    CborWriter(uint8_t* aBuffer, uint16_t aSize)
+        : mBuffer(aBuffer)
+        , mSize(aSize)
+        , mLength(0)
+        , mHasOverflowed(false)
+    {
+    }
+
+    uint16_t GetLength() const { return mLength; }
+
+    // Error is sticky so record can be written without checking every call
+    bool HasOverflowed() const { return mHasOverflowed; }
+
+    void WriteUint(uint32_t aValue) { WriteHead(kCborUnsigned, aValue); }
+
+    void WriteInt(int32_t aValue)
+    {
+        if (aValue < 0)
+        {
+            WriteHead(kCborNegative, static_cast<uint32_t>(-(aValue + 1)));
+        }
+        else
+        {
+            WriteHead(kCborUnsigned, static_cast<uint32_t>(aValue));
+        }
+    }
+
+    // Float is written as half precision when it is lossless, otherwise as single precision
+    void WriteFloat(float aValue)
+    {
+        uint32_t bits;
+        uint16_t half;
+
+        memcpy(&bits, &aValue, sizeof(bits));
+        if (FloatToHalf(bits, half))
+        {
+            WriteByte((kCborSimple << 5) | 25);
+            WriteByte(static_cast<uint8_t>(half >> 8));
+            WriteByte(static_cast<uint8_t>(half));
+        }
+        else
+        {
+            WriteByte((kCborSimple << 5) | 26);
+            WriteByte(static_cast<uint8_t>(bits >> 24));
+            WriteByte(static_cast<uint8_t>(bits >> 16));
+            WriteByte(static_cast<uint8_t>(bits >> 8));
+            WriteByte(static_cast<uint8_t>(bits));
+        }
+    }
+
+    void WriteBool(bool aValue) { WriteByte((kCborSimple << 5) | (aValue ? 21 : 20)); }
+
+    void WriteText(const char* aText) { WriteString(kCborText, aText, static_cast<uint16_t>(strlen(aText))); }
+
+    void WriteBytes(const uint8_t* aData, uint16_t aLength) { WriteString(kCborBytes, aData, aLength); }
+
+    void BeginArray(uint16_t aCount) { WriteHead(kCborArray, aCount); }
+
+    // Map is followed by aCount key and value pairs
+    void BeginMap(uint16_t aCount) { WriteHead(kCborMap, aCount); }
+
+private:
+    static bool FloatToHalf(uint32_t aBits, uint16_t &aHalf)
+    {
+        uint16_t sign = static_cast<uint16_t>((aBits >> 16) & 0x8000);
+        int32_t exponent = static_cast<int32_t>((aBits >> 23) & 0xff) - 127;
+        uint32_t mantissa = aBits & 0x7fffff;
+
+        if ((aBits & 0x7fffffff) == 0)
+        {
+            aHalf = sign;
+            return true;
+        }
+        // Only normal half precision numbers without lost mantissa bits
+        if (exponent < -14 || exponent > 15 || (mantissa & 0x1fff) != 0)
+        {
+            return false;
+        }
+        aHalf = static_cast<uint16_t>(sign | ((exponent + 15) << 10) | (mantissa >> 13));
+        return true;
+    }
+
+    void WriteByte(uint8_t aByte)
+    {
+        if (mLength >= mSize)
+        {
+            mHasOverflowed = true;
+            return;
+        }
+        mBuffer[mLength++] = aByte;
+    }
+
+    // Write major type with argument in the shortest form
+    void WriteHead(uint8_t aMajorType, uint32_t aValue)
+    {
+        uint8_t type = static_cast<uint8_t>(aMajorType << 5);
+
+        if (aValue < 24)
+        {
+            WriteByte(type | static_cast<uint8_t>(aValue));
+        }
+        else if (aValue <= 0xff)
+        {
+            WriteByte(type | 24);
+            WriteByte(static_cast<uint8_t>(aValue));
+        }
+        else if (aValue <= 0xffff)
+        {
+            WriteByte(type | 25);
+            WriteByte(static_cast<uint8_t>(aValue >> 8));
+            WriteByte(static_cast<uint8_t>(aValue));
+        }
+        else
+        {
+            WriteByte(type | 26);
+            WriteByte(static_cast<uint8_t>(aValue >> 24));
+            WriteByte(static_cast<uint8_t>(aValue >> 16));
+            WriteByte(static_cast<uint8_t>(aValue >> 8));
+            WriteByte(static_cast<uint8_t>(aValue));
+        }
+    }
+
+    void WriteString(uint8_t aMajorType, const void* aData, uint16_t aLength)
+    {
+        WriteHead(aMajorType, aLength);
+        if (mHasOverflowed || aLength > mSize - mLength)
+        {
+            mHasOverflowed = true;
+            return;
+        }
+        memcpy(mBuffer + mLength, aData, aLength);
+        mLength += aLength;
+    }
+
+    uint8_t* mBuffer;
+    uint16_t mSize;
+    uint16_t mLength;
+    bool mHasOverflowed;
+};
+
+class CborReader
+{
+public:
+    CborReader(const uint8_t* aData, uint16_t aLength)
+        : mData(aData)
+        , mLength(aLength)
+        , mOffset(0)
+    {
+    }
+
+    bool IsAtEnd() const { return mOffset >= mLength; }
+
+    bool ReadUint(uint32_t &aValue) { return ReadHead(kCborUnsigned, aValue); }
+
+    bool ReadInt(int32_t &aValue)
+    {
+        uint16_t offset = mOffset;
+        uint32_t value;
+
+        if (ReadHead(kCborUnsigned, value) && value <= 0x7fffffff)
+        {
+            aValue = static_cast<int32_t>(value);
+            return true;
+        }
+        mOffset = offset;
+        if (ReadHead(kCborNegative, value) && value <= 0x7fffffff)
+        {
+            aValue = -static_cast<int32_t>(value) - 1;
+            return true;
+        }
+        mOffset = offset;
+        return false;
+    }
+
+    // Read half or single precision float
+    bool ReadFloat(float &aValue)
+    {
+        uint32_t bits;
+
+        if (mOffset >= mLength)
+        {
+            return false;
+        }
+        if (mData[mOffset] == ((kCborSimple << 5) | 25) && mLength - mOffset >= 3)
+        {
+            bits = HalfToFloat(static_cast<uint16_t>((mData[mOffset + 1] << 8) | mData[mOffset + 2]));
+            mOffset += 3;
+        }
+        else if (mData[mOffset] == ((kCborSimple << 5) | 26) && mLength - mOffset >= 5)
+        {
+            bits = (static_cast<uint32_t>(mData[mOffset + 1]) << 24) | (static_cast<uint32_t>(mData[mOffset + 2]) << 16)
+                | (static_cast<uint32_t>(mData[mOffset + 3]) << 8) | mData[mOffset + 4];
+            mOffset += 5;
+        }
+        else
+        {
+            return false;
+        }
+        memcpy(&aValue, &bits, sizeof(aValue));
+        return true;
+    }
+
+    // Text is not copied, aText points into the payload and is not null terminated
+    bool ReadText(const char* &aText, uint16_t &aLength)
+    {
+        uint32_t length;
+        uint16_t offset = mOffset;
+
+        if (!ReadHead(kCborText, length) || length > static_cast<uint32_t>(mLength - mOffset))
+        {
+            mOffset = offset;
+            return false;
+        }
+        aText = reinterpret_cast<const char *>(mData + mOffset);
+        aLength = static_cast<uint16_t>(length);
+        mOffset += aLength;
+        return true;
+    }
+
+    bool ReadMapStart(uint32_t &aCount) { return ReadHead(kCborMap, aCount); }
+
+    bool ReadArrayStart(uint32_t &aCount) { return ReadHead(kCborArray, aCount); }
+
+    // Skip one item of unknown key, nested items are skipped up to the limited depth
+    bool Skip() { return SkipItem(4); }
+
+private:
+    static uint32_t HalfToFloat(uint16_t aHalf)
+    {
+        uint32_t sign = static_cast<uint32_t>(aHalf & 0x8000) << 16;
+        uint32_t exponent = (aHalf >> 10) & 0x1f;
+        uint32_t mantissa = aHalf & 0x3ff;
+
+        if (exponent == 0)
+        {
+            // Zero or subnormal number
+            float value = static_cast<float>(mantissa) / 16777216.0f;
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return sign | bits;
+        }
+        if (exponent == 0x1f)
+        {
+            return sign | 0x7f800000 | (mantissa << 13);
+        }
+        return sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    bool ReadHead(uint8_t aMajorType, uint32_t &aValue)
+    {
+        uint8_t info;
+        uint8_t size;
+
+        if (mOffset >= mLength || (mData[mOffset] >> 5) != aMajorType)
+        {
+            return false;
+        }
+        info = mData[mOffset] & 0x1f;
+        if (info < 24)
+        {
+            aValue = info;
+            mOffset++;
+            return true;
+        }
+        if (info > 26)
+        {
+            // 64-bit and indefinite lengths are not supported
+            return false;
+        }
+        size = static_cast<uint8_t>(1 << (info - 24));
+        if (mLength - mOffset - 1 < size)
+        {
+            return false;
+        }
+        aValue = 0;
+        for (uint8_t i = 1; i <= size; i++)
+        {
+            aValue = (aValue << 8) | mData[mOffset + i];
+        }
+        mOffset += 1 + size;
+        return true;
+    }
+
+    bool SkipItem(uint8_t aDepth)
+    {
+        uint8_t majorType;
+        uint32_t value;
+
+        if (mOffset >= mLength || aDepth == 0)
+        {
+            return false;
+        }
+        majorType = mData[mOffset] >> 5;
+        if (majorType == kCborSimple)
+        {
+            float dummy;
+            if (ReadFloat(dummy))
+            {
+                return true;
+            }
+            // Simple values false, true, null and undefined
+            if ((mData[mOffset] & 0x1f) < 24)
+            {
+                mOffset++;
+                return true;
+            }
+            return false;
+        }
+        if (!ReadHead(majorType, value))
+        {
+            return false;
+        }
+        switch (majorType)
+        {
+        case kCborBytes:
+        case kCborText:
+            if (value > static_cast<uint32_t>(mLength - mOffset))
+            {
+                return false;
+            }
+            mOffset += static_cast<uint16_t>(value);
+            return true;
+        case kCborMap:
+        case kCborArray:
+            if (majorType == kCborMap)
+            {
+                if (value > 0xffff)
+                {
+                    return false;
+                }
+                value *= 2;
+            }
+            for (uint32_t i = 0; i < value; i++)
+            {
+                if (!SkipItem(aDepth - 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        case kCborTag:
+            return SkipItem(aDepth - 1);
+        default:
+            return true;
+        }
+    }
+
+    const uint8_t* mData;
+    uint16_t mLength;
+    uint16_t mOffset;
+};
+
+#endif // CBOR_HPP_
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2018, Vit Holasek
+#  All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are met:
+#  1. Redistributions of source code must retain the above copyright
+#     notice, this list of conditions and the following disclaimer.
+#  2. Redistributions in binary form must reproduce the above copyright
+#     notice, this list of conditions and the following disclaimer in the
+#     documentation and/or other materials provided with the distribution.
+#  3. Neither the name of the copyright holder nor the
+#     names of its contributors may be used to endorse or promote products
+#     derived from this software without specific prior written permission.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+#  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+#  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+#  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+#  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+#  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+#  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+#  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+#  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+#  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+#  POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Decode CBOR sensor records published by the example on the MQTT broker side
+# and print them as JSON. Requires paho-mqtt package, CBOR decoder is built in
+# so no other dependency is needed.
+#
+# Usage: decode_cbor.py <mqtt-broker> [topic]
+
+import json
+import struct
+import sys
+
+import paho.mqtt.client as mqtt
+
+# Must match RecordKey in main.cpp
+RECORD_KEYS = {1: 'temperature', 2: 'humidity', 3: 'battery_mv', 4: 'seq'}
+
+
+def decode_half(value):
+    sign = -1.0 if value & 0x8000 else 1.0
+    exponent = (value >> 10) & 0x1f
+    mantissa = value & 0x3ff
+    if exponent == 0:
+        return sign * mantissa * 2.0 ** -24
+    if exponent == 0x1f:
+        return sign * float('inf') if mantissa == 0 else float('nan')
+    return sign * (1024 + mantissa) * 2.0 ** (exponent - 25)
+
+
+def decode_item(data, offset):
+    """Decode one CBOR item, return value and offset of the next item."""
+    head = data[offset]
+    major_type = head >> 5
+    info = head & 0x1f
+    offset += 1
+    if major_type == 7:
+        if info == 25:
+            return decode_half(struct.unpack_from('>H', data, offset)[0]), offset + 2
+        if info == 26:
+            return struct.unpack_from('>f', data, offset)[0], offset + 4
+        if info == 27:
+            return struct.unpack_from('>d', data, offset)[0], offset + 8
+        return {20: False, 21: True, 22: None}.get(info), offset
+    if info < 24:
+        argument = info
+    elif info <= 27:
+        size = 1 << (info - 24)
+        argument = int.from_bytes(data[offset:offset + size], 'big')
+        offset += size
+    else:
+        raise ValueError('Indefinite length items are not supported')
+    if major_type == 0:
+        return argument, offset
+    if major_type == 1:
+        return -1 - argument, offset
+    if major_type == 2:
+        return data[offset:offset + argument].hex(), offset + argument
+    if major_type == 3:
+        return data[offset:offset + argument].decode('utf-8'), offset + argument
+    if major_type == 4:
+        items = []
+        for _ in range(argument):
+            item, offset = decode_item(data, offset)
+            items.append(item)
+        return items, offset
+    if major_type == 5:
+        items = {}
+        for _ in range(argument):
+            key, offset = decode_item(data, offset)
+            value, offset = decode_item(data, offset)
+            items[RECORD_KEYS.get(key, key)] = value
+        return items, offset
+    # Tag value is ignored
+    return decode_item(data, offset)
+
+
+def on_message(client, userdata, message):
+    try:
+        record, _ = decode_item(message.payload, 0)
+    except (IndexError, ValueError, struct.error) as error:
+        print('Malformed record on %s: %s' % (message.topic, error), file=sys.stderr)
+        return
+    print(json.dumps(record))
+    sys.stdout.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: decode_cbor.py <mqtt-broker> [topic]', file=sys.stderr)
+        return 1
+    topic = sys.argv[2] if len(sys.argv) > 2 else 'sensors'
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(sys.argv[1], 1883)
+    client.subscribe(topic, qos=1)
+    client.loop_forever()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
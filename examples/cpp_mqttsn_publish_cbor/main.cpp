@@ -0,0 +1,296 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#include "cbor.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+#define CONFIG_TOPIC_NAME "config"
+#define PAYLOAD_MAX_LENGTH 48
+// Range of publish interval in seconds accepted from configuration message
+#define PUBLISH_INTERVAL_MIN_S 1
+#define PUBLISH_INTERVAL_MAX_S 86400
+
+// Integer map keys of sensor record, host side decoder uses the same mapping
+enum RecordKey
+{
+    kKeyTemperature = 1,
+    kKeyHumidity = 2,
+    kKeyBatteryMillivolts = 3,
+    kKeySequence = 4
+};
+
+// Integer map keys of configuration message
+enum ConfigKey
+{
+    kKeyPublishInterval = 1
+};
+
+using namespace ot::Mqttsn;
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static uint32_t sPublishInterval = 10;
+static uint16_t sSequence = 0;
+static otMqttsnTopic sTopic;
+static ot::TimerMilli* sPublishTimer = NULL;
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received configuration encoded as CBOR map
+    CborReader reader(aPayload, static_cast<uint16_t>(aPayloadLength));
+    uint32_t count;
+
+    if (!reader.ReadMapStart(count))
+    {
+        return kCodeAccepted;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t key;
+        if (!reader.ReadUint(key))
+        {
+            break;
+        }
+        if (key == kKeyPublishInterval)
+        {
+            uint32_t interval;
+            if (!reader.ReadUint(interval))
+            {
+                break;
+            }
+            // Clamp remote value so it can neither flood the mesh nor overflow timer delay
+            if (interval < PUBLISH_INTERVAL_MIN_S)
+            {
+                interval = PUBLISH_INTERVAL_MIN_S;
+            }
+            if (interval > PUBLISH_INTERVAL_MAX_S)
+            {
+                interval = PUBLISH_INTERVAL_MAX_S;
+            }
+            sPublishInterval = interval;
+        }
+        else if (!reader.Skip())
+        {
+            // Unknown keys are ignored for compatibility with newer configuration
+            break;
+        }
+    }
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+}
+
+static void HandlePublishTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    // Publish record encoded as CBOR map with integer keys, 17 to 19 bytes
+    // depending on sequence number instead of about 70 bytes of equivalent JSON
+    uint8_t data[PAYLOAD_MAX_LENGTH];
+    CborWriter writer(data, sizeof(data));
+
+    writer.BeginMap(4);
+    writer.WriteUint(kKeyTemperature);
+    writer.WriteFloat(24.0f);
+    writer.WriteUint(kKeyHumidity);
+    writer.WriteFloat(45.2f);
+    writer.WriteUint(kKeyBatteryMillivolts);
+    writer.WriteUint(3010);
+    writer.WriteUint(kKeySequence);
+    writer.WriteUint(sSequence++);
+    if (!writer.HasOverflowed() && sClient->GetState() == kStateActive)
+    {
+        sClient->Publish(data, writer.GetLength(), kQos1, false,
+            *static_cast<const Topic *>(&sTopic), HandlePublished, NULL);
+    }
+    // Interval may be changed by configuration message
+    sPublishTimer->Start(sPublishInterval * 1000);
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Start periodic publishing to the registered topic
+        sTopic = *aTopic;
+        sPublishTimer->Start(sPublishInterval * 1000);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Set callback for received messages
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        sClient->Subscribe(Topic::FromTopicName(CONFIG_TOPIC_NAME), kQos1, HandleSubscribed, NULL);
+        // Obtain target topic ID
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli publishTimer(instance, HandlePublishTimer, NULL);
+    sPublishTimer = &publishTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,257 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// IEEE 802.15.4 frame size and estimated overhead of all layers below MQTT-SN payload
+#define FRAME_SIZE 127
+// Frame control, sequence number, PAN ID, short addresses and FCS
+#define MAC_HEADER_SIZE 11
+// Auxiliary security header with key index and 32-bit MIC
+#define MAC_SECURITY_SIZE 10
+// Mesh header used when frame is forwarded by routers
+#define MESH_HEADER_SIZE 5
+// IPHC with context ID, source IID inline and off-mesh gateway address inline
+#define IPHC_HEADER_SIZE 27
+// Compressed UDP header with ports which cannot be compressed
+#define UDP_HEADER_SIZE 7
+// PUBLISH header: length, type, flags, topic ID and message ID
+#define PUBLISH_HEADER_SIZE 7
+
+// Define to 1 when the gateway is known to be one hop away so frames never get mesh header
+#ifndef GATEWAY_ONE_HOP
+#define GATEWAY_ONE_HOP 0
+#endif
+// Reject publishes which would be fragmented instead of sending them, define to 0 to send them anyway
+#ifndef PUBLISH_STRICT_SIZE
+#define PUBLISH_STRICT_SIZE 1
+#endif
+
+using namespace ot::Mqttsn;
+
+struct FragmentationCounters
+{
+    uint32_t mSingleFrameCount;
+    uint32_t mFragmentedCount;
+    uint32_t mRejectedCount;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static FragmentationCounters sFragmentationCounters;
+
+// Maximal PUBLISH payload which fits into one 802.15.4 frame. Topic ID field
+// has two bytes for normal, predefined and short topic name alike, so the
+// limit depends only on the route to the gateway.
+static int32_t GetMaxSingleFramePayload()
+{
+    int32_t size = FRAME_SIZE - MAC_HEADER_SIZE - MAC_SECURITY_SIZE - IPHC_HEADER_SIZE
+        - UDP_HEADER_SIZE - PUBLISH_HEADER_SIZE;
+
+    // Frame forwarded over multiple hops gets mesh header on the way, even when
+    // it was sent by a child without it, so it is reserved for every role
+#if !GATEWAY_ONE_HOP
+    size -= MESH_HEADER_SIZE;
+#endif
+    return size;
+}
+
+static otError PublishSized(const uint8_t* aData, int32_t aLength, Qos aQos, const Topic &aTopic,
+    otMqttsnPublishedHandler aHandler, void* aContext)
+{
+    if (aLength <= GetMaxSingleFramePayload())
+    {
+        sFragmentationCounters.mSingleFrameCount++;
+    }
+    else
+    {
+#if PUBLISH_STRICT_SIZE
+        sFragmentationCounters.mRejectedCount++;
+        return OT_ERROR_NO_BUFS;
+#else
+        sFragmentationCounters.mFragmentedCount++;
+#endif
+    }
+    return sClient->Publish(aData, aLength, aQos, false, aTopic, aHandler, aContext);
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Include optional fields only when message still fits into single frame
+        char data[FRAME_SIZE];
+        int32_t length = snprintf(data, sizeof(data),
+            "{\"temperature\":24.0,\"humidity\":45.2,\"battery\":3.01,\"uptime\":86400}");
+        if (length > GetMaxSingleFramePayload())
+        {
+            length = snprintf(data, sizeof(data), "{\"temperature\":24.0}");
+        }
+        PublishSized(reinterpret_cast<const uint8_t *>(data), length, kQos1,
+            *static_cast<const Topic *>(aTopic), HandlePublished, NULL);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Host tool printing MQTT-SN gateway predefined topics file from topic manifest.
+// Build and run: c++ -std=c++11 -o gen_predefined_topics gen_predefined_topics.cpp
+//                ./gen_predefined_topics [client-id] > predefinedTopic.conf
+// Default client ID "*" makes topics predefined for all clients.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "topic_manifest.h"
+
+int main(int aArgc, char *aArgv[])
+{
+    const char *clientId = aArgc > 1 ? aArgv[1] : "*";
+
+    // Refuse inconsistent manifest which would map one ID to more topics
+    for (uint16_t i = 0; i < kTopicManifestSize; i++)
+    {
+        if (kTopicManifest[i].mTopicId == 0)
+        {
+            fprintf(stderr, "Topic %s uses reserved ID 0\n", kTopicManifest[i].mName);
+            return 1;
+        }
+        for (uint16_t j = 0; j < i; j++)
+        {
+            if (kTopicManifest[i].mTopicId == kTopicManifest[j].mTopicId
+                || strcmp(kTopicManifest[i].mName, kTopicManifest[j].mName) == 0)
+            {
+                fprintf(stderr, "Topics %s and %s are in conflict\n", kTopicManifest[j].mName,
+                    kTopicManifest[i].mName);
+                return 1;
+            }
+        }
+    }
+
+    printf("# ClientId, TopicName, TopicId\n");
+    for (uint16_t i = 0; i < kTopicManifestSize; i++)
+    {
+        printf("%s, %s, %u\n", clientId, kTopicManifest[i].mName,
+            static_cast<unsigned int>(kTopicManifest[i].mTopicId));
+    }
+    return 0;
+}
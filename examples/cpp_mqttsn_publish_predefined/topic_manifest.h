@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TOPIC_MANIFEST_H_
+#define TOPIC_MANIFEST_H_
+
+#include <stdint.h>
+
+// Topic names and predefined topic IDs agreed with the gateway. Gateway
+// configuration is generated from the same list by gen_predefined_topics.cpp.
+// Topic ID 0 is reserved and must not be used.
+#define TOPIC_MANIFEST(TOPIC) \
+    TOPIC("sensors/temperature", 1) \
+    TOPIC("sensors/humidity", 2) \
+    TOPIC("alarms", 3)
+
+struct TopicManifestEntry
+{
+    const char *mName;
+    uint16_t mTopicId;
+};
+
+#define TOPIC_MANIFEST_ENTRY(aName, aTopicId) { aName, aTopicId },
+static constexpr TopicManifestEntry kTopicManifest[] = { TOPIC_MANIFEST(TOPIC_MANIFEST_ENTRY) };
+#undef TOPIC_MANIFEST_ENTRY
+
+static constexpr uint16_t kTopicManifestSize = sizeof(kTopicManifest) / sizeof(kTopicManifest[0]);
+
+constexpr bool TopicNameEquals(const char *aFirst, const char *aSecond)
+{
+    return *aFirst == *aSecond && (*aFirst == '\0' || TopicNameEquals(aFirst + 1, aSecond + 1));
+}
+
+// True when no entry after aIndex shares name or topic ID with entry aIndex
+constexpr bool TopicManifestEntryIsUnique(uint16_t aIndex, uint16_t aOther)
+{
+    return aOther >= kTopicManifestSize ? true
+        : kTopicManifest[aIndex].mTopicId != kTopicManifest[aOther].mTopicId
+            && !TopicNameEquals(kTopicManifest[aIndex].mName, kTopicManifest[aOther].mName)
+            && TopicManifestEntryIsUnique(aIndex, aOther + 1);
+}
+
+constexpr bool TopicManifestIsUnique(uint16_t aIndex = 0)
+{
+    return aIndex >= kTopicManifestSize ? true
+        : TopicManifestEntryIsUnique(aIndex, aIndex + 1) && TopicManifestIsUnique(aIndex + 1);
+}
+
+constexpr bool TopicManifestHasZeroId(uint16_t aIndex = 0)
+{
+    return aIndex >= kTopicManifestSize ? false
+        : kTopicManifest[aIndex].mTopicId == 0 || TopicManifestHasZeroId(aIndex + 1);
+}
+
+// Firmware build fails on invalid manifest the same way as gateway configuration generator
+static_assert(!TopicManifestHasZeroId(), "Topic ID 0 is reserved and must not be used in topic manifest");
+static_assert(TopicManifestIsUnique(), "Topic names and topic IDs in topic manifest must be unique");
+
+// Resolve topic name to predefined topic ID at compile time, 0 when name is not in manifest
+constexpr uint16_t FindPredefinedTopicId(const char *aName, uint16_t aIndex = 0)
+{
+    return aIndex >= kTopicManifestSize ? 0
+        : TopicNameEquals(kTopicManifest[aIndex].mName, aName) ? kTopicManifest[aIndex].mTopicId
+        : FindPredefinedTopicId(aName, aIndex + 1);
+}
+
+#endif // TOPIC_MANIFEST_H_
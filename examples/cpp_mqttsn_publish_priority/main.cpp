@@ -0,0 +1,508 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/random.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define STATUS_TOPIC_NAME "status"
+#define ALARM_TOPIC_NAME "alarms"
+#define TELEMETRY_TOPIC_NAME "sensors"
+// Commands are received on this topic and acknowledged on status topic
+#define COMMAND_TOPIC_NAME "commands"
+// Number of topics registered before publishing starts
+#define REGISTERED_TOPIC_COUNT 3
+
+// Maximal number of QoS 1 messages waiting for PUBACK at the same time
+#define PUBLISH_WINDOW_SIZE 4
+// Window slots which can be used only by control and alarm messages
+#define PUBLISH_WINDOW_RESERVED 1
+// Number of messages waiting for transmission in all priority classes
+#define OUTBOUND_POOL_SIZE 16
+#define PUBLISH_MAX_ATTEMPTS 3
+#define PAYLOAD_MAX_LENGTH 48
+#define TELEMETRY_INTERVAL_MS 5000
+// Bulk upload of buffered readings every BULK_EVERY telemetry periods
+#define BULK_EVERY 12
+#define BULK_MESSAGE_COUNT 8
+// Simulated temperature reading range in tenths of degree and alarm threshold
+#define TEMPERATURE_MIN 200
+#define TEMPERATURE_MAX 650
+#define TEMPERATURE_ALARM 600
+
+using namespace ot::Mqttsn;
+
+// Publish priority classes from the most urgent
+enum PublishPriority
+{
+    kPriorityControl,
+    kPriorityAlarm,
+    kPriorityTelemetry,
+    kPriorityBulk,
+    kPriorityCount
+};
+
+struct OutboundMessage
+{
+    OutboundMessage *mNext;
+    bool mIsUsed;
+    bool mIsInFlight;
+    PublishPriority mPriority;
+    uint8_t mAttempts;
+    const otMqttsnTopic *mTopic;
+    uint8_t mData[PAYLOAD_MAX_LENGTH];
+    int32_t mLength;
+};
+
+// FIFO of messages waiting in one priority class
+struct PriorityQueue
+{
+    OutboundMessage *mHead;
+    OutboundMessage *mTail;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// Control and alarm classes are served with strict priority, remaining
+// classes share the window by weighted round robin so bulk is not starved
+static const uint8_t sClassWeights[kPriorityCount] = { 0, 0, 3, 1 };
+
+static OutboundMessage sOutboundPool[OUTBOUND_POOL_SIZE];
+static PriorityQueue sQueues[kPriorityCount];
+static uint8_t sClassCredits[kPriorityCount] = { 0, 0, 3, 1 };
+static uint8_t sWeightedClass = kPriorityTelemetry;
+static uint8_t sInFlightCount = 0;
+static otMqttsnTopic sStatusTopic;
+static otMqttsnTopic sAlarmTopic;
+static otMqttsnTopic sTelemetryTopic;
+static uint8_t sRegisteredCount = 0;
+static ot::TimerMilli* sTelemetryTimer = NULL;
+static uint16_t sSequence = 0;
+
+static void QueuePushBack(PriorityQueue &aQueue, OutboundMessage &aMessage)
+{
+    aMessage.mNext = NULL;
+    if (aQueue.mTail == NULL)
+    {
+        aQueue.mHead = &aMessage;
+    }
+    else
+    {
+        aQueue.mTail->mNext = &aMessage;
+    }
+    aQueue.mTail = &aMessage;
+}
+
+static void QueuePushFront(PriorityQueue &aQueue, OutboundMessage &aMessage)
+{
+    aMessage.mNext = aQueue.mHead;
+    aQueue.mHead = &aMessage;
+    if (aQueue.mTail == NULL)
+    {
+        aQueue.mTail = &aMessage;
+    }
+}
+
+static OutboundMessage *QueuePopFront(PriorityQueue &aQueue)
+{
+    OutboundMessage *message = aQueue.mHead;
+    if (message != NULL)
+    {
+        aQueue.mHead = message->mNext;
+        if (aQueue.mHead == NULL)
+        {
+            aQueue.mTail = NULL;
+        }
+    }
+    return message;
+}
+
+static OutboundMessage *AllocateMessage(PublishPriority aPriority)
+{
+    for (uint8_t i = 0; i < OUTBOUND_POOL_SIZE; i++)
+    {
+        if (!sOutboundPool[i].mIsUsed)
+        {
+            return &sOutboundPool[i];
+        }
+    }
+    // Pool is full, drop oldest waiting message of lower priority class
+    for (int8_t priority = kPriorityCount - 1; priority > aPriority; priority--)
+    {
+        OutboundMessage *message = QueuePopFront(sQueues[priority]);
+        if (message != NULL)
+        {
+            return message;
+        }
+    }
+    return NULL;
+}
+
+// Select class of the next transmitted message, kPriorityCount when there is nothing to send
+static uint8_t SchedulerSelectClass()
+{
+    for (uint8_t priority = 0; priority < kPriorityCount; priority++)
+    {
+        if (sClassWeights[priority] == 0 && sQueues[priority].mHead != NULL)
+        {
+            return priority;
+        }
+    }
+    // Weighted classes are not allowed to the reserved part of the window
+    if (sInFlightCount >= PUBLISH_WINDOW_SIZE - PUBLISH_WINDOW_RESERVED)
+    {
+        return kPriorityCount;
+    }
+    for (uint8_t i = 0; i <= kPriorityCount; i++)
+    {
+        if (sClassCredits[sWeightedClass] > 0 && sQueues[sWeightedClass].mHead != NULL)
+        {
+            sClassCredits[sWeightedClass]--;
+            return sWeightedClass;
+        }
+        // Class used its share or is empty, move to next one and refill its credits
+        do
+        {
+            sWeightedClass = (sWeightedClass + 1) % kPriorityCount;
+        } while (sClassWeights[sWeightedClass] == 0);
+        sClassCredits[sWeightedClass] = sClassWeights[sWeightedClass];
+    }
+    return kPriorityCount;
+}
+
+static void SchedulerRun();
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OutboundMessage &message = *static_cast<OutboundMessage *>(aContext);
+    // Handle published
+
+    if (!message.mIsInFlight)
+    {
+        // Message was released on disconnect
+        return;
+    }
+    message.mIsInFlight = false;
+    sInFlightCount--;
+    if (aCode != kCodeAccepted && message.mAttempts < PUBLISH_MAX_ATTEMPTS)
+    {
+        // Retransmission waits at the head of its own class so it does not
+        // overtake more urgent messages
+        QueuePushFront(sQueues[message.mPriority], message);
+    }
+    else
+    {
+        message.mIsUsed = false;
+    }
+    SchedulerRun();
+}
+
+static void SchedulerRun()
+{
+    if (sClient->GetState() != kStateActive || sRegisteredCount < REGISTERED_TOPIC_COUNT)
+    {
+        return;
+    }
+    while (sInFlightCount < PUBLISH_WINDOW_SIZE)
+    {
+        uint8_t priority = SchedulerSelectClass();
+        OutboundMessage *message;
+
+        if (priority == kPriorityCount)
+        {
+            break;
+        }
+        message = QueuePopFront(sQueues[priority]);
+        message->mAttempts++;
+        if (sClient->Publish(message->mData, message->mLength, kQos1, false,
+            *static_cast<const Topic *>(message->mTopic), HandlePublished, message) != OT_ERROR_NONE)
+        {
+            // Not enough buffers, try again when next PUBACK is received
+            message->mAttempts--;
+            QueuePushFront(sQueues[priority], *message);
+            break;
+        }
+        message->mIsInFlight = true;
+        sInFlightCount++;
+    }
+}
+
+// Queue message to be published in given priority class
+static otError PublishWithPriority(const otMqttsnTopic &aTopic, const char *aData, PublishPriority aPriority)
+{
+    OutboundMessage *message;
+    int32_t length = static_cast<int32_t>(strlen(aData));
+
+    // Check length first, allocation may drop a waiting message of lower priority
+    if (length > PAYLOAD_MAX_LENGTH)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    message = AllocateMessage(aPriority);
+    if (message == NULL)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    message->mIsUsed = true;
+    message->mIsInFlight = false;
+    message->mPriority = aPriority;
+    message->mAttempts = 0;
+    message->mTopic = &aTopic;
+    message->mLength = length;
+    memcpy(message->mData, aData, length);
+    QueuePushBack(sQueues[aPriority], *message);
+    SchedulerRun();
+    return OT_ERROR_NONE;
+}
+
+static void HandleTelemetryTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    char data[PAYLOAD_MAX_LENGTH];
+    // Simulated sensor reading in tenths of degree
+    uint32_t temperature = ot::Random::NonCrypto::GetUint32InRange(TEMPERATURE_MIN, TEMPERATURE_MAX + 1);
+
+    snprintf(data, sizeof(data), "{\"seq\":%u,\"temperature\":%u.%u}",
+        static_cast<unsigned int>(sSequence), static_cast<unsigned int>(temperature / 10),
+        static_cast<unsigned int>(temperature % 10));
+    PublishWithPriority(sTelemetryTopic, data, kPriorityTelemetry);
+    if (temperature > TEMPERATURE_ALARM)
+    {
+        // Alarm overtakes all waiting telemetry and bulk messages
+        PublishWithPriority(sAlarmTopic, "{\"alarm\":\"overheat\"}", kPriorityAlarm);
+    }
+    if (sSequence % BULK_EVERY == 0)
+    {
+        // Upload history which is not time critical
+        for (uint8_t i = 0; i < BULK_MESSAGE_COUNT; i++)
+        {
+            snprintf(data, sizeof(data), "{\"history\":%u,\"temperature\":24.0}", static_cast<unsigned int>(i));
+            PublishWithPriority(sTelemetryTopic, data, kPriorityBulk);
+        }
+    }
+    sSequence++;
+    sTelemetryTimer->StartAt(sTelemetryTimer->GetFireTime(), TELEMETRY_INTERVAL_MS);
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from command topic
+
+    // Command acknowledgement overtakes all other waiting messages
+    PublishWithPriority(sStatusTopic, "{\"command\":\"accepted\"}", kPriorityControl);
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        *static_cast<otMqttsnTopic *>(aContext) = *aTopic;
+        sRegisteredCount++;
+        if (sRegisteredCount == REGISTERED_TOPIC_COUNT)
+        {
+            // Report device is online before any queued telemetry
+            PublishWithPriority(sStatusTopic, "{\"status\":\"online\"}", kPriorityControl);
+        }
+        SchedulerRun();
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sRegisteredCount = 0;
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        sClient->Subscribe(Topic::FromTopicName(COMMAND_TOPIC_NAME), kQos1, HandleSubscribed, NULL);
+        sClient->Register(STATUS_TOPIC_NAME, HandleRegistered, &sStatusTopic);
+        sClient->Register(ALARM_TOPIC_NAME, HandleRegistered, &sAlarmTopic);
+        sClient->Register(TELEMETRY_TOPIC_NAME, HandleRegistered, &sTelemetryTopic);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    // Topic IDs and messages waiting for PUBACK are not valid in next session, start over
+    sRegisteredCount = 0;
+    sInFlightCount = 0;
+    sWeightedClass = kPriorityTelemetry;
+    for (uint8_t priority = 0; priority < kPriorityCount; priority++)
+    {
+        sQueues[priority].mHead = NULL;
+        sQueues[priority].mTail = NULL;
+        sClassCredits[priority] = sClassWeights[priority];
+    }
+    for (uint8_t i = 0; i < OUTBOUND_POOL_SIZE; i++)
+    {
+        sOutboundPool[i].mIsUsed = false;
+        sOutboundPool[i].mIsInFlight = false;
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli telemetryTimer(instance, HandleTelemetryTimer, NULL);
+    sTelemetryTimer = &telemetryTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+    telemetryTimer.Start(TELEMETRY_INTERVAL_MS);
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
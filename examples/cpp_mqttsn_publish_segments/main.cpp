@@ -0,0 +1,223 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/udp.h"
+#include "openthread/message.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_PORT 10000
+
+// Predefined topic ID configured on the gateway
+#define TOPIC_ID 1
+// PUBLISH message type and flags for QoS -1 and predefined topic ID
+#define PUBLISH_MSG_TYPE 0x0c
+#define PUBLISH_FLAGS_QOSM1_PREDEFINED 0x61
+// PUBLISH header: length (1), message type (1), flags (1), topic ID (2) and message ID (2)
+#define PUBLISH_HEADER_SIZE 7
+
+// Largest PUBLISH payload which fits into one 802.15.4 frame: 127 bytes minus MAC header (11),
+// MAC security (10), mesh header (5), IPHC (27), UDP (7) and PUBLISH header (7).
+// See cpp_mqttsn_publish_mtu example for the breakdown.
+#define PUBLISH_PAYLOAD_MAX_SIZE 60
+
+// Part of the payload referenced in place, e.g. constant JSON fragment or sensor record
+struct PayloadSegment
+{
+    const void* mData;
+    uint16_t mLength;
+};
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static otUdpSocket sSocket;
+
+static void HandleUdpReceive(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    OT_UNUSED_VARIABLE(aMessage);
+    OT_UNUSED_VARIABLE(aMessageInfo);
+    // Nothing is expected from gateway for QoS -1 PUBLISH
+}
+
+// MqttsnClient::Publish accepts only one flat buffer and copies it to its own message. QoS -1
+// PUBLISH needs no connection, so the datagram is built here directly: the header is appended
+// first and then every segment is appended from where it lives, without intermediate buffer.
+static otError PublishSegments(otInstance* aInstance, const PayloadSegment* aSegments, uint8_t aCount,
+    uint16_t aTopicId)
+{
+    otError error = OT_ERROR_NONE;
+    uint8_t header[PUBLISH_HEADER_SIZE];
+    uint16_t length = 0;
+    otMessageInfo messageInfo;
+    otMessage* message;
+
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        length += aSegments[i].mLength;
+    }
+    // Single byte length field is used, payload is also limited to keep PUBLISH in one frame
+    if (length > PUBLISH_PAYLOAD_MAX_SIZE)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    header[0] = static_cast<uint8_t>(PUBLISH_HEADER_SIZE + length);
+    header[1] = PUBLISH_MSG_TYPE;
+    header[2] = PUBLISH_FLAGS_QOSM1_PREDEFINED;
+    header[3] = static_cast<uint8_t>(aTopicId >> 8);
+    header[4] = static_cast<uint8_t>(aTopicId & 0xff);
+    // Message ID is not relevant for QoS -1
+    header[5] = 0;
+    header[6] = 0;
+
+    message = otUdpNewMessage(aInstance, NULL);
+    if (message == NULL)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    memset(&messageInfo, 0, sizeof(messageInfo));
+    otIp6AddressFromString(GATEWAY_ADDRESS, &messageInfo.mPeerAddr);
+    messageInfo.mPeerPort = GATEWAY_PORT;
+
+    SuccessOrExit(error = otMessageAppend(message, header, sizeof(header)));
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        SuccessOrExit(error = otMessageAppend(message, aSegments[i].mData, aSegments[i].mLength));
+    }
+    SuccessOrExit(error = otUdpSend(&sSocket, message, &messageInfo));
+    return OT_ERROR_NONE;
+
+exit:
+    otMessageFree(message);
+    return error;
+}
+
+static void Publish(otInstance* aInstance)
+{
+    // Publish message composed of constant parts and measured value
+    static const char prefix[] = "{\"temperature\":";
+    static const char suffix[] = "}";
+    const char* value = "24.0";
+    PayloadSegment segments[] = {
+        { prefix, sizeof(prefix) - 1 },
+        { value, static_cast<uint16_t>(strlen(value)) },
+        { suffix, sizeof(suffix) - 1 },
+    };
+    PublishSegments(aInstance, segments, sizeof(segments) / sizeof(segments[0]), TOPIC_ID);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles then publish
+        if (role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+        {
+            Publish(&instance);
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Open UDP socket for MQTT-SN messages
+    otSockAddr sockAddr;
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.mPort = CLIENT_PORT;
+    SuccessOrExit(error = otUdpOpen(&instance, &sSocket, HandleUdpReceive, NULL));
+    SuccessOrExit(error = otUdpBind(&sSocket, &sockAddr));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,323 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// Maximal number of QoS 1 messages waiting for PUBACK at the same time
+#define PUBLISH_WINDOW_SIZE 4
+// Number of messages published by this example
+#define PUBLISH_COUNT 32
+// Maximal number of attempts to deliver one message when client retransmissions time out
+#define PUBLISH_MAX_ATTEMPTS 3
+#define PAYLOAD_MAX_LENGTH 48
+// Delay before publishing is retried when no message buffer was available for empty window
+#define REFILL_RETRY_DELAY_MS 1000
+
+using namespace ot::Mqttsn;
+
+// Slot of the in-flight window. Slot pointer is passed as callback context
+// so PUBACKs are matched to the message no matter in which order they arrive.
+struct InFlightMessage
+{
+    bool mIsUsed;
+    uint16_t mSequence;
+    uint8_t mAttempts;
+};
+
+static MqttsnClient* sClient = NULL;
+static ot::TimerMilli* sRefillTimer = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static otMqttsnTopic sTopic;
+static InFlightMessage sWindow[PUBLISH_WINDOW_SIZE];
+static uint8_t sInFlightCount = 0;
+static uint16_t sNextSequence = 0;
+static uint16_t sDeliveredCount = 0;
+static uint16_t sFailedCount = 0;
+static uint16_t sRetransmittedCount = 0;
+
+static void FillWindow();
+
+static uint8_t GetInFlightCount()
+{
+    // Report current depth of the in-flight window
+    return sInFlightCount;
+}
+
+static void ReleaseSlot(InFlightMessage &aSlot)
+{
+    aSlot.mIsUsed = false;
+    sInFlightCount--;
+}
+
+static otError PublishSlot(InFlightMessage &aSlot);
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    InFlightMessage &slot = *static_cast<InFlightMessage *>(aContext);
+    // Handle published
+
+    if (!slot.mIsUsed)
+    {
+        // Slot was already released on disconnect
+        return;
+    }
+
+    if (aCode == kCodeAccepted)
+    {
+        sDeliveredCount++;
+        ReleaseSlot(slot);
+    }
+    else if (slot.mAttempts < PUBLISH_MAX_ATTEMPTS && PublishSlot(slot) == OT_ERROR_NONE)
+    {
+        // Client gave up retransmitting or gateway is congested, keep the slot and send message again
+        sRetransmittedCount++;
+    }
+    else
+    {
+        sFailedCount++;
+        ReleaseSlot(slot);
+    }
+
+    // Acknowledged slot may be reused immediately
+    FillWindow();
+}
+
+static otError PublishSlot(InFlightMessage &aSlot)
+{
+    char data[PAYLOAD_MAX_LENGTH];
+    int32_t length = snprintf(data, sizeof(data), "{\"seq\":%u,\"temperature\":24.0}",
+        static_cast<unsigned int>(aSlot.mSequence));
+    aSlot.mAttempts++;
+    return sClient->Publish(reinterpret_cast<const uint8_t *>(data), length, kQos1, false,
+        *static_cast<const Topic *>(&sTopic), HandlePublished, &aSlot);
+}
+
+static void FillWindow()
+{
+    // Publish new messages until all window slots are waiting for PUBACK
+    for (uint8_t i = 0; i < PUBLISH_WINDOW_SIZE && GetInFlightCount() < PUBLISH_WINDOW_SIZE
+        && sNextSequence < PUBLISH_COUNT; i++)
+    {
+        InFlightMessage &slot = sWindow[i];
+        if (slot.mIsUsed)
+        {
+            continue;
+        }
+        slot.mIsUsed = true;
+        slot.mSequence = sNextSequence;
+        slot.mAttempts = 0;
+        if (PublishSlot(slot) != OT_ERROR_NONE)
+        {
+            // Not enough buffers, try again when next PUBACK releases a slot. There is no PUBACK
+            // to wait for when the window is empty so retry after a delay.
+            slot.mIsUsed = false;
+            if (GetInFlightCount() == 0)
+            {
+                sRefillTimer->Start(REFILL_RETRY_DELAY_MS);
+            }
+            break;
+        }
+        sInFlightCount++;
+        sNextSequence++;
+    }
+}
+
+static void HandleRefillTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    if (sClient->GetState() == kStateActive)
+    {
+        FillWindow();
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Start pipelined publishing to the registered topic
+        sTopic = *aTopic;
+        FillWindow();
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    // Messages waiting for PUBACK are lost with the session, release their slots
+    for (uint8_t i = 0; i < PUBLISH_WINDOW_SIZE; i++)
+    {
+        if (sWindow[i].mIsUsed)
+        {
+            sWindow[i].mIsUsed = false;
+            sFailedCount++;
+        }
+    }
+    sInFlightCount = 0;
+    sRefillTimer->Stop();
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected and disconnected callbacks
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli refillTimer(instance, HandleRefillTimer, NULL);
+    sRefillTimer = &refillTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
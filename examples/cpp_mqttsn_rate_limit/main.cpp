@@ -0,0 +1,471 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread/message.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+#define PAYLOAD_MAX_LENGTH 48
+
+// Airtime budget of the whole client in messages per second and burst size
+#define CLIENT_RATE 10
+#define CLIENT_BURST 20
+// Budget of the sensor topic
+#define TOPIC_RATE 2
+#define TOPIC_BURST 5
+#define TOPIC_LIMIT_COUNT 1
+// Local transmit queue depth from which the refill rate is halved or quartered
+#define SEND_QUEUE_LOW 4
+#define SEND_QUEUE_HIGH 8
+#define FREE_BUFFERS_LOW 8
+// Refill rate is divided by at most 2^RATE_SHIFT_MAX when local transmit queue is congested
+#define RATE_SHIFT_MAX 2
+// Tokens are counted in 1/TOKEN_SCALE of token. Rate in tokens per second divided by
+// 2^RATE_SHIFT_MAX is still a whole number of these units per millisecond.
+#define TOKEN_SCALE (1000 << RATE_SHIFT_MAX)
+
+using namespace ot::Mqttsn;
+
+// What to do with publish exceeding the budget
+enum RateLimitMode
+{
+    // Publish fails with OT_ERROR_BUSY
+    kRateLimitReject,
+    // Message replaces older deferred message of the topic and is sent when budget allows
+    kRateLimitDefer
+};
+
+// Token counts are kept in 1/TOKEN_SCALE of token so no fraction is lost on refill
+struct TokenBucket
+{
+    uint32_t mRate;
+    uint32_t mBurst;
+    uint32_t mTokens;
+    uint32_t mLastRefill;
+};
+
+struct DeferredPublish
+{
+    bool mIsUsed;
+    uint8_t mData[PAYLOAD_MAX_LENGTH];
+    int32_t mLength;
+    Qos mQos;
+    otMqttsnPublishedHandler mHandler;
+    void *mContext;
+};
+
+struct TopicLimit
+{
+    otMqttsnTopic mTopic;
+    TokenBucket mBucket;
+    DeferredPublish mDeferred;
+};
+
+struct RateLimitCounters
+{
+    uint32_t mSentCount;
+    uint32_t mRejectedCount;
+    uint32_t mDeferredCount;
+    // Deferred messages replaced by newer ones
+    uint32_t mConflatedCount;
+};
+
+static MqttsnClient* sClient = NULL;
+static otInstance* sInstance = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static TokenBucket sClientBucket;
+static TopicLimit sTopicLimits[TOPIC_LIMIT_COUNT];
+static RateLimitCounters sRateLimitCounters;
+static ot::TimerMilli* sDeferredTimer = NULL;
+static otMqttsnTopic sTopic;
+static bool sTopicRegistered = false;
+static uint16_t sSequence = 0;
+
+static void TokenBucketInit(TokenBucket &aBucket, uint32_t aRate, uint32_t aBurst)
+{
+    aBucket.mRate = aRate;
+    aBucket.mBurst = aBurst;
+    aBucket.mTokens = aBurst * TOKEN_SCALE;
+    aBucket.mLastRefill = ot::TimerMilli::GetNow().GetValue();
+}
+
+// Token units credited per millisecond with rate divided by 2^aRateShift
+static uint32_t TokenBucketGetRefillPerMs(const TokenBucket &aBucket, uint8_t aRateShift)
+{
+    return (aBucket.mRate << RATE_SHIFT_MAX) >> aRateShift;
+}
+
+// Refill bucket with rate divided by 2^aRateShift when local transmit queue is congested,
+// whole elapsed time is credited exactly
+static void TokenBucketRefill(TokenBucket &aBucket, uint8_t aRateShift)
+{
+    uint32_t now = ot::TimerMilli::GetNow().GetValue();
+    uint32_t elapsed = now - aBucket.mLastRefill;
+
+    aBucket.mLastRefill = now;
+    if (elapsed > aBucket.mBurst * 1000)
+    {
+        // Prevent overflow, bucket is full anyway
+        elapsed = aBucket.mBurst * 1000;
+    }
+    aBucket.mTokens += elapsed * TokenBucketGetRefillPerMs(aBucket, aRateShift);
+    if (aBucket.mTokens > aBucket.mBurst * TOKEN_SCALE)
+    {
+        aBucket.mTokens = aBucket.mBurst * TOKEN_SCALE;
+    }
+}
+
+// Milliseconds until one token is available
+static uint32_t TokenBucketGetWait(const TokenBucket &aBucket, uint8_t aRateShift)
+{
+    uint32_t refill = TokenBucketGetRefillPerMs(aBucket, aRateShift);
+
+    if (aBucket.mTokens >= TOKEN_SCALE)
+    {
+        return 0;
+    }
+    if (refill == 0)
+    {
+        // Bucket with zero rate never refills, check again later
+        return 1000;
+    }
+    return (TOKEN_SCALE - aBucket.mTokens + refill - 1) / refill;
+}
+
+static uint8_t GetCongestionShift()
+{
+    otBufferInfo info;
+
+    // Slow down when messages pile up in the local 6LoWPAN send queue,
+    // the radio cannot deliver them as fast as they are produced
+    otMessageGetBufferInfo(sInstance, &info);
+    if (info.m6loSendMessages >= SEND_QUEUE_HIGH || info.mFreeBuffers < FREE_BUFFERS_LOW)
+    {
+        return RATE_SHIFT_MAX;
+    }
+    if (info.m6loSendMessages >= SEND_QUEUE_LOW)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static TopicLimit *FindTopicLimit(const otMqttsnTopic &aTopic)
+{
+    for (uint8_t i = 0; i < TOPIC_LIMIT_COUNT; i++)
+    {
+        if (sTopicLimits[i].mTopic.mType == aTopic.mType
+            && sTopicLimits[i].mTopic.mData.mTopicId == aTopic.mData.mTopicId)
+        {
+            return &sTopicLimits[i];
+        }
+    }
+    return NULL;
+}
+
+// Take one token from client bucket and topic bucket if it is limited,
+// zero is returned on success, otherwise time to wait for next token
+static uint32_t RateLimitAcquire(TopicLimit *aLimit)
+{
+    uint8_t shift = GetCongestionShift();
+    uint32_t wait;
+
+    TokenBucketRefill(sClientBucket, shift);
+    wait = TokenBucketGetWait(sClientBucket, shift);
+    if (aLimit != NULL)
+    {
+        uint32_t topicWait;
+        TokenBucketRefill(aLimit->mBucket, shift);
+        topicWait = TokenBucketGetWait(aLimit->mBucket, shift);
+        wait = topicWait > wait ? topicWait : wait;
+    }
+    if (wait > 0)
+    {
+        return wait;
+    }
+    sClientBucket.mTokens -= TOKEN_SCALE;
+    if (aLimit != NULL)
+    {
+        aLimit->mBucket.mTokens -= TOKEN_SCALE;
+    }
+    return 0;
+}
+
+static void ScheduleDeferred(uint32_t aWait)
+{
+    if (!sDeferredTimer->IsRunning() || aWait < sDeferredTimer->GetFireTime() - ot::TimerMilli::GetNow())
+    {
+        sDeferredTimer->Start(aWait);
+    }
+}
+
+static otError PublishLimited(const uint8_t* aData, int32_t aLength, Qos aQos, const otMqttsnTopic &aTopic,
+    otMqttsnPublishedHandler aHandler, void* aContext, RateLimitMode aMode)
+{
+    TopicLimit *limit = FindTopicLimit(aTopic);
+    uint32_t wait = RateLimitAcquire(limit);
+
+    if (wait == 0)
+    {
+        sRateLimitCounters.mSentCount++;
+        return sClient->Publish(aData, aLength, aQos, false, *static_cast<const Topic *>(&aTopic), aHandler, aContext);
+    }
+    // Only limited topics have storage for deferred message
+    if (aMode == kRateLimitReject || limit == NULL || aLength > PAYLOAD_MAX_LENGTH)
+    {
+        sRateLimitCounters.mRejectedCount++;
+        return OT_ERROR_BUSY;
+    }
+    // Keep only the newest value, older reading is obsolete anyway
+    if (limit->mDeferred.mIsUsed)
+    {
+        sRateLimitCounters.mConflatedCount++;
+    }
+    limit->mDeferred.mIsUsed = true;
+    memcpy(limit->mDeferred.mData, aData, aLength);
+    limit->mDeferred.mLength = aLength;
+    limit->mDeferred.mQos = aQos;
+    limit->mDeferred.mHandler = aHandler;
+    limit->mDeferred.mContext = aContext;
+    sRateLimitCounters.mDeferredCount++;
+    ScheduleDeferred(wait);
+    return OT_ERROR_NONE;
+}
+
+static void HandleDeferredTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    for (uint8_t i = 0; i < TOPIC_LIMIT_COUNT; i++)
+    {
+        TopicLimit &limit = sTopicLimits[i];
+        DeferredPublish &deferred = limit.mDeferred;
+        uint32_t wait;
+
+        if (!deferred.mIsUsed)
+        {
+            continue;
+        }
+        if (sClient->GetState() != kStateActive)
+        {
+            // Deferred messages are not valid in new session
+            deferred.mIsUsed = false;
+            continue;
+        }
+        wait = RateLimitAcquire(&limit);
+        if (wait > 0)
+        {
+            ScheduleDeferred(wait);
+            continue;
+        }
+        deferred.mIsUsed = false;
+        sRateLimitCounters.mSentCount++;
+        sClient->Publish(deferred.mData, deferred.mLength, deferred.mQos, false,
+            *static_cast<const Topic *>(&limit.mTopic), deferred.mHandler, deferred.mContext);
+    }
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+}
+
+static void Publish()
+{
+    char data[PAYLOAD_MAX_LENGTH];
+    int32_t length = snprintf(data, sizeof(data), "{\"seq\":%u,\"temperature\":24.0}",
+        static_cast<unsigned int>(sSequence++));
+
+    // Sensor loop may call this much faster than the budget, limiter sends the newest value
+    PublishLimited(reinterpret_cast<const uint8_t *>(data), length, kQos0, sTopic,
+        HandlePublished, NULL, kRateLimitDefer);
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        sTopic = *aTopic;
+        sTopicRegistered = true;
+        // Assign budget to the topic
+        sTopicLimits[0].mTopic = *aTopic;
+        TokenBucketInit(sTopicLimits[0].mBucket, TOPIC_RATE, TOPIC_BURST);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    sTopicRegistered = false;
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli deferredTimer(instance, HandleDeferredTimer, NULL);
+    sInstance = &instance;
+    sDeferredTimer = &deferredTimer;
+    TokenBucketInit(sClientBucket, CLIENT_RATE, CLIENT_BURST);
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+        // Misbehaving sensor loop publishing on every iteration
+        if (sTopicRegistered)
+        {
+            Publish();
+        }
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
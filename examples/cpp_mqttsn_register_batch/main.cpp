@@ -0,0 +1,356 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Maximal number of requests in one batch
+#define BATCH_MAX_SIZE 16
+
+using namespace ot::Mqttsn;
+
+struct Batch;
+
+typedef void (*BatchHandler)(const Batch &aBatch, void* aContext);
+
+// Result of one REGISTER or SUBSCRIBE request in the batch
+struct BatchItem
+{
+    Batch* mBatch;
+    otMqttsnReturnCode mCode;
+    otMqttsnTopic mTopic;
+    otMqttsnQos mQos;
+};
+
+// All requests are sent back-to-back, each with its own message ID assigned
+// by the client. Item pointer is used as callback context so REGACK and SUBACK
+// may arrive in any order. Completion callback is called once for the batch.
+struct Batch
+{
+    BatchItem mItems[BATCH_MAX_SIZE];
+    uint8_t mCount;
+    uint8_t mPendingCount;
+    uint8_t mAcceptedCount;
+    BatchHandler mCallback;
+    void* mContext;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// Topics published by the device
+static const char* sSensorTopicNames[] = {
+    "building/floor1/room12/sensors/temperature",
+    "building/floor1/room12/sensors/humidity",
+    "building/floor1/room12/sensors/pressure",
+    "building/floor1/room12/sensors/co2",
+};
+
+// Topics with commands for the device
+static const char* sControlTopicNames[] = {
+    "building/floor1/room12/control/config",
+    "building/floor1/room12/control/reset",
+};
+
+static Batch sRegisterBatch;
+static Batch sSubscribeBatch;
+
+static void BatchInit(Batch &aBatch, uint8_t aCount, BatchHandler aCallback, void* aContext)
+{
+    memset(&aBatch, 0, sizeof(aBatch));
+    aBatch.mCount = aCount;
+    // One extra pending count guards the batch until all requests are sent
+    aBatch.mPendingCount = aCount + 1;
+    aBatch.mCallback = aCallback;
+    aBatch.mContext = aContext;
+}
+
+static void BatchRelease(Batch &aBatch)
+{
+    if (--aBatch.mPendingCount == 0)
+    {
+        aBatch.mCallback(aBatch, aBatch.mContext);
+    }
+}
+
+static void BatchItemFinished(BatchItem &aItem, otMqttsnReturnCode aCode)
+{
+    aItem.mCode = aCode;
+    if (aCode == kCodeAccepted)
+    {
+        aItem.mBatch->mAcceptedCount++;
+    }
+    BatchRelease(*aItem.mBatch);
+}
+
+static void HandleBatchRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    BatchItem &item = *static_cast<BatchItem *>(aContext);
+
+    if (aCode == kCodeAccepted)
+    {
+        item.mTopic = *aTopic;
+    }
+    BatchItemFinished(item, aCode);
+}
+
+static void HandleBatchSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    BatchItem &item = *static_cast<BatchItem *>(aContext);
+
+    if (aCode == kCodeAccepted)
+    {
+        item.mTopic = *aTopic;
+        item.mQos = aQos;
+    }
+    BatchItemFinished(item, aCode);
+}
+
+static otError RegisterBatch(Batch &aBatch, const char* const* aTopicNames, uint8_t aCount,
+    BatchHandler aCallback, void* aContext)
+{
+    if (aCount == 0 || aCount > BATCH_MAX_SIZE)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    BatchInit(aBatch, aCount, aCallback, aContext);
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        BatchItem &item = aBatch.mItems[i];
+        item.mBatch = &aBatch;
+        if (sClient->Register(aTopicNames[i], HandleBatchRegistered, &item) != OT_ERROR_NONE)
+        {
+            // Request was not sent, report it as rejected in batch result
+            BatchItemFinished(item, kCodeRejectedCongestion);
+        }
+    }
+    BatchRelease(aBatch);
+    return OT_ERROR_NONE;
+}
+
+static otError SubscribeBatch(Batch &aBatch, const otMqttsnTopic* aTopics, uint8_t aCount, Qos aQos,
+    BatchHandler aCallback, void* aContext)
+{
+    if (aCount == 0 || aCount > BATCH_MAX_SIZE)
+    {
+        return OT_ERROR_INVALID_ARGS;
+    }
+    BatchInit(aBatch, aCount, aCallback, aContext);
+    for (uint8_t i = 0; i < aCount; i++)
+    {
+        BatchItem &item = aBatch.mItems[i];
+        item.mBatch = &aBatch;
+        if (sClient->Subscribe(*static_cast<const Topic *>(&aTopics[i]), aQos, HandleBatchSubscribed, &item) != OT_ERROR_NONE)
+        {
+            // Request was not sent, report it as rejected in batch result
+            BatchItemFinished(item, kCodeRejectedCongestion);
+        }
+    }
+    BatchRelease(aBatch);
+    return OT_ERROR_NONE;
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from control topics
+
+    return kCodeAccepted;
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+}
+
+static void HandleRegisterBatch(const Batch &aBatch, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle all topics registered
+
+    // Publish initial value to every successfully registered topic
+    for (uint8_t i = 0; i < aBatch.mCount; i++)
+    {
+        const BatchItem &item = aBatch.mItems[i];
+        if (item.mCode == kCodeAccepted)
+        {
+            const char* data = "{\"value\":0}";
+            int32_t length = strlen(data);
+            sClient->Publish(reinterpret_cast<const uint8_t *>(data), length, kQos1, false,
+                *static_cast<const Topic *>(&item.mTopic), HandlePublished, NULL);
+        }
+    }
+}
+
+static void HandleSubscribeBatch(const Batch &aBatch, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aBatch);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle all control topics subscribed
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        otMqttsnTopic controlTopics[sizeof(sControlTopicNames) / sizeof(sControlTopicNames[0])];
+        uint8_t controlCount = sizeof(sControlTopicNames) / sizeof(sControlTopicNames[0]);
+
+        // Set callback for received messages
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        // Obtain all topic IDs and subscribe control topics at once
+        RegisterBatch(sRegisterBatch, sSensorTopicNames,
+            sizeof(sSensorTopicNames) / sizeof(sSensorTopicNames[0]), HandleRegisterBatch, NULL);
+        for (uint8_t i = 0; i < controlCount; i++)
+        {
+            controlTopics[i] = Topic::FromTopicName(sControlTopicNames[i]);
+        }
+        SubscribeBatch(sSubscribeBatch, controlTopics, controlCount, kQos1, HandleSubscribeBatch, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
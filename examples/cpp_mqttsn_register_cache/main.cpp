@@ -0,0 +1,377 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "openthread/instance.h"
+#include "openthread/platform/settings.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// Settings keys from 0x8000 are not used by OpenThread core and are free for application data
+#define SETTINGS_KEY_TOPIC_CACHE 0x8001
+// Maximal number of cached topic registrations
+#define TOPIC_CACHE_SIZE 8
+#define TOPIC_NAME_MAX_LENGTH 31
+// Maximal number of registrations waiting for REGACK
+#define REGISTER_PENDING_SIZE 4
+
+using namespace ot::Mqttsn;
+
+struct TopicCacheEntry
+{
+    TopicId mTopicId;
+    char mTopicName[TOPIC_NAME_MAX_LENGTH + 1];
+};
+
+// Topic IDs are valid only within one gateway session, so the whole cache is
+// bound to gateway address, port and client ID. It is stored as a single
+// settings record to keep flash writes rare.
+struct TopicCache
+{
+    otIp6Address mGatewayAddress;
+    uint16_t mGatewayPort;
+    char mClientId[24];
+    uint8_t mCount;
+    TopicCacheEntry mEntries[TOPIC_CACHE_SIZE];
+};
+
+struct RegisterRequest
+{
+    bool mIsUsed;
+    char mTopicName[TOPIC_NAME_MAX_LENGTH + 1];
+    otMqttsnRegisteredHandler mCallback;
+    void* mContext;
+};
+
+static MqttsnClient* sClient = NULL;
+static otInstance* sInstance = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static TopicCache sTopicCache;
+static otMqttsnTopic sTopic;
+static RegisterRequest sRegisterRequests[REGISTER_PENDING_SIZE];
+
+static void TopicCacheLoad()
+{
+    uint16_t length = sizeof(sTopicCache);
+    if (otPlatSettingsGet(sInstance, SETTINGS_KEY_TOPIC_CACHE, 0,
+            reinterpret_cast<uint8_t *>(&sTopicCache), &length) != OT_ERROR_NONE
+        || length != sizeof(sTopicCache) || sTopicCache.mCount > TOPIC_CACHE_SIZE)
+    {
+        memset(&sTopicCache, 0, sizeof(sTopicCache));
+    }
+}
+
+static void TopicCacheSave()
+{
+    otPlatSettingsSet(sInstance, SETTINGS_KEY_TOPIC_CACHE,
+        reinterpret_cast<const uint8_t *>(&sTopicCache), sizeof(sTopicCache));
+}
+
+static bool TopicCacheMatchesSession(const MqttsnConfig &aConfig)
+{
+    return memcmp(&sTopicCache.mGatewayAddress, &aConfig.GetAddress(), sizeof(otIp6Address)) == 0
+        && sTopicCache.mGatewayPort == aConfig.GetPort()
+        && strncmp(sTopicCache.mClientId, aConfig.GetClientId(), sizeof(sTopicCache.mClientId)) == 0;
+}
+
+static void TopicCacheBindSession(const MqttsnConfig &aConfig)
+{
+    // Registrations from other gateway or with clean session are not valid anymore
+    if (aConfig.GetCleanSession() || !TopicCacheMatchesSession(aConfig))
+    {
+        memset(&sTopicCache, 0, sizeof(sTopicCache));
+        memcpy(&sTopicCache.mGatewayAddress, &aConfig.GetAddress(), sizeof(otIp6Address));
+        sTopicCache.mGatewayPort = aConfig.GetPort();
+        strncpy(sTopicCache.mClientId, aConfig.GetClientId(), sizeof(sTopicCache.mClientId) - 1);
+        TopicCacheSave();
+    }
+}
+
+static TopicCacheEntry *TopicCacheFind(const char* aTopicName)
+{
+    for (uint8_t i = 0; i < sTopicCache.mCount; i++)
+    {
+        if (strcmp(sTopicCache.mEntries[i].mTopicName, aTopicName) == 0)
+        {
+            return &sTopicCache.mEntries[i];
+        }
+    }
+    return NULL;
+}
+
+static void TopicCacheAdd(const char* aTopicName, TopicId aTopicId)
+{
+    TopicCacheEntry *entry = TopicCacheFind(aTopicName);
+    if (entry == NULL)
+    {
+        if (sTopicCache.mCount == TOPIC_CACHE_SIZE)
+        {
+            // Cache is full, drop the oldest registration
+            memmove(&sTopicCache.mEntries[0], &sTopicCache.mEntries[1],
+                sizeof(TopicCacheEntry) * (TOPIC_CACHE_SIZE - 1));
+            sTopicCache.mCount--;
+        }
+        entry = &sTopicCache.mEntries[sTopicCache.mCount++];
+        strncpy(entry->mTopicName, aTopicName, TOPIC_NAME_MAX_LENGTH);
+        entry->mTopicName[TOPIC_NAME_MAX_LENGTH] = '\0';
+    }
+    else if (entry->mTopicId == aTopicId)
+    {
+        return;
+    }
+    entry->mTopicId = aTopicId;
+    TopicCacheSave();
+}
+
+static void TopicCacheRemove(TopicId aTopicId)
+{
+    for (uint8_t i = 0; i < sTopicCache.mCount; i++)
+    {
+        if (sTopicCache.mEntries[i].mTopicId == aTopicId)
+        {
+            memmove(&sTopicCache.mEntries[i], &sTopicCache.mEntries[i + 1],
+                sizeof(TopicCacheEntry) * (sTopicCache.mCount - i - 1));
+            sTopicCache.mCount--;
+            TopicCacheSave();
+            return;
+        }
+    }
+}
+
+static void HandleCachedRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    RegisterRequest &request = *static_cast<RegisterRequest *>(aContext);
+    // Store topic ID received in REGACK
+
+    if (aCode == kCodeAccepted)
+    {
+        TopicCacheAdd(request.mTopicName, static_cast<const Topic *>(aTopic)->GetTopicId());
+    }
+    request.mIsUsed = false;
+    request.mCallback(aCode, aTopic, request.mContext);
+}
+
+static otError RegisterCached(const char* aTopicName, otMqttsnRegisteredHandler aCallback, void* aContext)
+{
+    TopicCacheEntry *entry = TopicCacheFind(aTopicName);
+    RegisterRequest *request = NULL;
+
+    if (entry != NULL)
+    {
+        // Topic ID is known from previous session, no REGISTER is sent
+        Topic topic = Topic::FromTopicId(entry->mTopicId);
+        aCallback(kCodeAccepted, &topic, aContext);
+        return OT_ERROR_NONE;
+    }
+
+    for (uint8_t i = 0; i < REGISTER_PENDING_SIZE; i++)
+    {
+        if (!sRegisterRequests[i].mIsUsed)
+        {
+            request = &sRegisterRequests[i];
+            break;
+        }
+    }
+    if (request == NULL || strlen(aTopicName) > TOPIC_NAME_MAX_LENGTH)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    request->mIsUsed = true;
+    strcpy(request->mTopicName, aTopicName);
+    request->mCallback = aCallback;
+    request->mContext = aContext;
+    otError error = sClient->Register(aTopicName, HandleCachedRegistered, request);
+    if (error != OT_ERROR_NONE)
+    {
+        request->mIsUsed = false;
+    }
+    return error;
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext);
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle published
+
+    if (aCode == kCodeRejectedTopicId)
+    {
+        // Gateway does not know cached topic ID anymore, register topic again
+        TopicCacheRemove(static_cast<const Topic *>(&sTopic)->GetTopicId());
+        RegisterCached(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Publish message to the registered topic
+        const char* data = "{\"temperature\":24.0}";
+        int32_t length = strlen(data);
+        sTopic = *aTopic;
+        sClient->Publish(reinterpret_cast<const uint8_t *>(data), length, kQos1, false,
+            *static_cast<const Topic *>(aTopic), HandlePublished, NULL);
+    }
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID from cache or by REGISTER
+        RegisterCached(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    // Session is kept by the gateway so cached topic IDs stay valid
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(false);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    TopicCacheBindSession(config);
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sInstance = &instance;
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+
+    // Restore topic registrations from previous run
+    TopicCacheLoad();
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,383 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Session is resumed only when link was down shorter than this time
+#define SESSION_RESUME_TIMEOUT_MS 60000
+#define PUBLISH_INTERVAL_MS 10000
+// Maximal number of QoS 1 messages kept until PUBACK is received
+#define PENDING_MESSAGE_COUNT 4
+#define PAYLOAD_MAX_LENGTH 48
+
+using namespace ot::Mqttsn;
+
+// Registered topic which survives reconnect when session is resumed
+struct SessionTopic
+{
+    const char *mName;
+    otMqttsnTopic mTopic;
+    bool mIsRegistered;
+};
+
+// Subscription which survives reconnect when session is resumed
+struct SessionSubscription
+{
+    const char *mFilter;
+    otMqttsnQos mQos;
+    bool mIsSubscribed;
+};
+
+// QoS 1 message kept until acknowledged so it can be resent after reconnect
+struct PendingMessage
+{
+    bool mIsUsed;
+    bool mIsSent;
+    SessionTopic *mTopic;
+    uint8_t mData[PAYLOAD_MAX_LENGTH];
+    int32_t mLength;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+static SessionTopic sTopics[] = {
+    { "sensors", otMqttsnTopic(), false },
+    { "status", otMqttsnTopic(), false }
+};
+static SessionSubscription sSubscriptions[] = {
+    { "control", kQos1, false }
+};
+static PendingMessage sPendingMessages[PENDING_MESSAGE_COUNT];
+static bool sSessionValid = false;
+static uint32_t sDisconnectedAt = 0;
+static uint16_t sSequence = 0;
+static ot::TimerMilli* sPublishTimer = NULL;
+
+static void SendPending();
+
+static void SessionClear()
+{
+    // Gateway forgets registrations and subscriptions on clean session,
+    // pending messages are kept and sent after topics are registered again
+    for (uint8_t i = 0; i < sizeof(sTopics) / sizeof(sTopics[0]); i++)
+    {
+        sTopics[i].mIsRegistered = false;
+    }
+    for (uint8_t i = 0; i < sizeof(sSubscriptions) / sizeof(sSubscriptions[0]); i++)
+    {
+        sSubscriptions[i].mIsSubscribed = false;
+    }
+    for (uint8_t i = 0; i < PENDING_MESSAGE_COUNT; i++)
+    {
+        sPendingMessages[i].mIsSent = false;
+    }
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from control topic
+
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    SessionSubscription &subscription = *static_cast<SessionSubscription *>(aContext);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    // Handle subscribed event
+
+    subscription.mIsSubscribed = (aCode == kCodeAccepted);
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    SessionTopic &topic = *static_cast<SessionTopic *>(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        topic.mTopic = *aTopic;
+        topic.mIsRegistered = true;
+        SendPending();
+    }
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    PendingMessage &message = *static_cast<PendingMessage *>(aContext);
+    // Handle published
+
+    if (aCode == kCodeAccepted)
+    {
+        message.mIsUsed = false;
+        return;
+    }
+    // Message is kept and sent again when session is active
+    message.mIsSent = false;
+    if (aCode == kCodeRejectedTopicId && message.mTopic->mIsRegistered)
+    {
+        // Gateway did not keep topic ID from previous session, register again
+        message.mTopic->mIsRegistered = false;
+        sClient->Register(message.mTopic->mName, HandleRegistered, message.mTopic);
+        return;
+    }
+    SendPending();
+}
+
+static void SendPending()
+{
+    if (sClient->GetState() != kStateActive)
+    {
+        return;
+    }
+    // Send only messages which were not acknowledged yet
+    for (uint8_t i = 0; i < PENDING_MESSAGE_COUNT; i++)
+    {
+        PendingMessage &message = sPendingMessages[i];
+        if (!message.mIsUsed || message.mIsSent || !message.mTopic->mIsRegistered)
+        {
+            continue;
+        }
+        if (sClient->Publish(message.mData, message.mLength, kQos1, false,
+            *static_cast<const Topic *>(&message.mTopic->mTopic), HandlePublished, &message) == OT_ERROR_NONE)
+        {
+            message.mIsSent = true;
+        }
+    }
+}
+
+static void SessionRestore()
+{
+    // Only state unknown to the gateway is restored, on resumed session
+    // this is nothing and just unacknowledged messages are sent
+    for (uint8_t i = 0; i < sizeof(sTopics) / sizeof(sTopics[0]); i++)
+    {
+        if (!sTopics[i].mIsRegistered)
+        {
+            sClient->Register(sTopics[i].mName, HandleRegistered, &sTopics[i]);
+        }
+    }
+    for (uint8_t i = 0; i < sizeof(sSubscriptions) / sizeof(sSubscriptions[0]); i++)
+    {
+        SessionSubscription &subscription = sSubscriptions[i];
+        if (!subscription.mIsSubscribed)
+        {
+            sClient->Subscribe(Topic::FromTopicName(subscription.mFilter), subscription.mQos,
+                HandleSubscribed, &subscription);
+        }
+    }
+    SendPending();
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        sSessionValid = true;
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        SessionRestore();
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    sDisconnectedAt = ot::TimerMilli::GetNow().GetValue();
+    for (uint8_t i = 0; i < PENDING_MESSAGE_COUNT; i++)
+    {
+        // PUBACKs for messages sent in lost connection will never come
+        sPendingMessages[i].mIsSent = false;
+    }
+    if (aType == kDisconnectServer)
+    {
+        // Gateway closed the session, it cannot be resumed
+        sSessionValid = false;
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+    // Link drop was short enough for gateway to still keep the session
+    bool resume = sSessionValid
+        && ot::TimerMilli::GetNow().GetValue() - sDisconnectedAt < SESSION_RESUME_TIMEOUT_MS;
+
+    if (!resume)
+    {
+        SessionClear();
+    }
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(!resume);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Register disconnected callback
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void HandlePublishTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    // Queue new reading even when disconnected, it is sent after reconnect
+    for (uint8_t i = 0; i < PENDING_MESSAGE_COUNT; i++)
+    {
+        PendingMessage &message = sPendingMessages[i];
+        if (message.mIsUsed)
+        {
+            continue;
+        }
+        message.mIsUsed = true;
+        message.mIsSent = false;
+        message.mTopic = &sTopics[0];
+        message.mLength = snprintf(reinterpret_cast<char *>(message.mData), sizeof(message.mData),
+            "{\"seq\":%u,\"temperature\":24.0}", static_cast<unsigned int>(sSequence++));
+        break;
+    }
+    SendPending();
+    sPublishTimer->StartAt(sPublishTimer->GetFireTime(), PUBLISH_INTERVAL_MS);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // Child to router transition keeps connection, only reattach after
+        // link loss ends up here with disconnected client and resumes the session
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli publishTimer(instance, HandlePublishTimer, NULL);
+    sPublishTimer = &publishTimer;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+    publishTimer.Start(PUBLISH_INTERVAL_MS);
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
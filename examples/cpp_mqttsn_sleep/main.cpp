@@ -53,6 +53,8 @@
 #define SLEEP_DURATION_MS 60000
 // Maximal awake time
 #define AWAKE_TIMEOUT_MS 2000
+// Sleep duration reported to the gateway is extended because of crystal precision deviation
+#define SLEEP_DURATION_MARGIN_MS 5000
 
 #define TOPIC_NAME "sensors"
 
@@ -63,7 +65,12 @@ static MqttsnClient* sClient = NULL;
 static const uint8_t sExpanId[] = EXTPANID;
 static const uint8_t sMasterKey[] = MASTER_KEY;
 
-static uint32_t sNextAwakeAt = 0xffffffff;
+// Sleep cycle state, awake is scheduled by timer so the main loop
+// only processes events and MCU may idle until the next one
+static ot::TimerMilli* sSleepCycleTimer = NULL;
+static bool sSleepCycleEnabled = false;
+static uint32_t sSleepDuration = 0;
+static uint32_t sAwakeTimeout = 0;
 
 static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
 {
@@ -76,16 +83,50 @@ static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t
     return kCodeAccepted;
 }
 
+static void HandleSleepCycleTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+
+    // Schedule next wakeup relative to this one so the period does not drift,
+    // timer handles clock wraparound
+    sSleepCycleTimer->StartAt(sSleepCycleTimer->GetFireTime(), sSleepDuration);
+    sClient->Awake(sAwakeTimeout);
+}
+
+static otError StartSleepCycle(uint32_t aSleepDuration, uint32_t aAwakeTimeout)
+{
+    otError error;
+
+    sSleepDuration = aSleepDuration;
+    sAwakeTimeout = aAwakeTimeout;
+    error = sClient->Sleep(aSleepDuration + SLEEP_DURATION_MARGIN_MS);
+    sSleepCycleEnabled = error == OT_ERROR_NONE;
+    return error;
+}
+
+static void StopSleepCycle()
+{
+    sSleepCycleEnabled = false;
+    sSleepCycleTimer->Stop();
+}
+
 static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
 {
-    OT_UNUSED_VARIABLE(aType);
     OT_UNUSED_VARIABLE(aContext);
     // Handle disconnect
 
-    if (aType == kDisconnectAsleep && sNextAwakeAt == 0xffffffff)
+    if (aType == kDisconnectAsleep)
+    {
+        // Handle asleep event, start awake timer with first transition to sleep
+        if (sSleepCycleEnabled && !sSleepCycleTimer->IsRunning())
+        {
+            sSleepCycleTimer->Start(sSleepDuration);
+        }
+    }
+    else
     {
-        // Handle asleep event
-        sNextAwakeAt = ot::TimerMilli::GetNow().GetValue() + SLEEP_DURATION_MS;
+        // Client is disconnected or lost, there is nothing to awake
+        StopSleepCycle();
     }
 }
 
@@ -97,9 +138,8 @@ static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTop
     OT_UNUSED_VARIABLE(aContext);
     // Handle subscribed event
 
-    // Go to sleep and schedule awake timer
-    // Add some time because of crystal precision deviation
-    sClient->Sleep(SLEEP_DURATION_MS + 5000);
+    // Go to sleep and awake periodically to receive buffered messages
+    StartSleepCycle(SLEEP_DURATION_MS, AWAKE_TIMEOUT_MS);
 }
 
 static void HandleConnected(ReturnCode aCode, void* aContext)
@@ -165,6 +205,8 @@ int main(int aArgc, char *aArgv[])
     sClient = &instance.Get<MqttsnClient>();
     ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
     ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli sleepCycleTimer(instance, HandleSleepCycleTimer, NULL);
+    sSleepCycleTimer = &sleepCycleTimer;
 
     // Set default network settings
     // Set network name
@@ -197,12 +239,6 @@ int main(int aArgc, char *aArgv[])
     {
         instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
         otSysProcessDrivers(&instance);
-        // Awake when scheduled time passed
-        if (ot::TimerMilli::GetNow().GetValue() > sNextAwakeAt)
-        {
-            sClient->Awake(AWAKE_TIMEOUT_MS);
-            sNextAwakeAt += SLEEP_DURATION_MS;
-        }
     }
     return 0;
 
@@ -0,0 +1,374 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread/link.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+// Duration in ms how long will MQTT-SN client stay in sleep mode
+#define SLEEP_DURATION_MS 60000
+// Initial awake time, it is enough for PINGRESP when gateway has nothing buffered
+#define AWAKE_TIMEOUT_MIN_MS 500
+// Maximal total awake time in one sleep cycle
+#define AWAKE_TIMEOUT_MAX_MS 8000
+// Awake period which ended this close to its timeout is considered timed out
+#define AWAKE_TIMEOUT_TOLERANCE_MS 50
+// Data poll period of sleepy end device while MQTT-SN transaction or awake window is in progress
+#define POLL_PERIOD_FAST_MS 250
+// Sleep duration reported to the gateway is extended because of crystal precision deviation
+#define SLEEP_DURATION_MARGIN_MS 5000
+
+#define TOPIC_NAME "sensors"
+
+using namespace ot::Mqttsn;
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// Sleep cycle state, awake is scheduled by timer so the main loop
+// only processes events and MCU may idle until the next one
+static ot::TimerMilli* sSleepCycleTimer = NULL;
+static otInstance* sInstance = NULL;
+static bool sSleepCycleEnabled = false;
+static uint32_t sSleepDuration = 0;
+
+// Statistics of one awake period used to tune energy versus latency
+struct AwakeCycleStats
+{
+    uint16_t mMessagesDrained;
+    uint32_t mAwakeTime;
+    uint8_t mExtensions;
+};
+
+// Awake window is started short and ends as soon as gateway answers PINGRESP
+// after its buffer is drained. It is extended while buffered messages keep
+// coming until the window timed out.
+static bool sIsAwake = false;
+static uint32_t sAwakeStartedAt = 0;
+static uint32_t sAwakeTimeout = 0;
+static uint16_t sWindowMessageCount = 0;
+static AwakeCycleStats sCycleStats;
+static AwakeCycleStats sLastCycleStats;
+
+// Link layer poll period follows MQTT-SN state when device is sleepy end device,
+// parent is polled often only when gateway is expected to send something. Poll
+// period computed by the stack is used otherwise, it fits Thread child timeout.
+static void SetPollPeriod(uint32_t aPollPeriod)
+{
+    if (otLinkGetPollPeriod(sInstance) != aPollPeriod)
+    {
+        otLinkSetPollPeriod(sInstance, aPollPeriod);
+    }
+}
+
+static void RestorePollPeriod()
+{
+    // Zero clears the user set period, stack computes it again from child timeout
+    SetPollPeriod(0);
+}
+
+static const AwakeCycleStats &GetLastCycleStats()
+{
+    return sLastCycleStats;
+}
+
+static void BeginAwake(uint32_t aTimeout)
+{
+    sAwakeStartedAt = ot::TimerMilli::GetNow().GetValue();
+    sAwakeTimeout = aTimeout;
+    sWindowMessageCount = 0;
+    // Poll fast so buffered messages and PINGRESP are received without delay
+    SetPollPeriod(POLL_PERIOD_FAST_MS);
+    sIsAwake = sClient->Awake(aTimeout) == OT_ERROR_NONE;
+    if (!sIsAwake)
+    {
+        RestorePollPeriod();
+    }
+}
+
+static void EndAwake()
+{
+    uint32_t elapsed = ot::TimerMilli::GetNow().GetValue() - sAwakeStartedAt;
+    bool timedOut = elapsed + AWAKE_TIMEOUT_TOLERANCE_MS >= sAwakeTimeout;
+    uint32_t remaining;
+
+    sIsAwake = false;
+    sCycleStats.mAwakeTime += elapsed;
+    remaining = sCycleStats.mAwakeTime < AWAKE_TIMEOUT_MAX_MS ? AWAKE_TIMEOUT_MAX_MS - sCycleStats.mAwakeTime : 0;
+    if (timedOut && sWindowMessageCount > 0 && remaining > 0)
+    {
+        // Gateway was still sending buffered messages, extend the window
+        sCycleStats.mExtensions++;
+        BeginAwake(2 * sAwakeTimeout < remaining ? 2 * sAwakeTimeout : remaining);
+        return;
+    }
+    sLastCycleStats = sCycleStats;
+    RestorePollPeriod();
+}
+
+static otMqttsnReturnCode HandlePublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from subscribed topic
+
+    if (sIsAwake)
+    {
+        sWindowMessageCount++;
+        sCycleStats.mMessagesDrained++;
+    }
+    return kCodeAccepted;
+}
+
+static void HandleSleepCycleTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    uint32_t awakeTimeout;
+
+    // Schedule next wakeup relative to this one so the period does not drift,
+    // timer handles clock wraparound
+    sSleepCycleTimer->StartAt(sSleepCycleTimer->GetFireTime(), sSleepDuration);
+    memset(&sCycleStats, 0, sizeof(sCycleStats));
+    // Start with window which was needed to drain the gateway last time,
+    // it still ends early when PINGRESP comes sooner
+    awakeTimeout = GetLastCycleStats().mAwakeTime;
+    if (awakeTimeout < AWAKE_TIMEOUT_MIN_MS)
+    {
+        awakeTimeout = AWAKE_TIMEOUT_MIN_MS;
+    }
+    if (awakeTimeout > AWAKE_TIMEOUT_MAX_MS)
+    {
+        awakeTimeout = AWAKE_TIMEOUT_MAX_MS;
+    }
+    BeginAwake(awakeTimeout);
+}
+
+static otError StartSleepCycle(uint32_t aSleepDuration)
+{
+    otError error;
+
+    sSleepDuration = aSleepDuration;
+    error = sClient->Sleep(aSleepDuration + SLEEP_DURATION_MARGIN_MS);
+    sSleepCycleEnabled = error == OT_ERROR_NONE;
+    return error;
+}
+
+static void StopSleepCycle()
+{
+    sSleepCycleEnabled = false;
+    sSleepCycleTimer->Stop();
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    if (aType == kDisconnectAsleep)
+    {
+        // Handle asleep event, start awake timer with first transition to sleep
+        if (sSleepCycleEnabled && !sSleepCycleTimer->IsRunning())
+        {
+            sSleepCycleTimer->Start(sSleepDuration);
+        }
+        // Awake period ended either by PINGRESP or by timeout
+        if (sIsAwake)
+        {
+            EndAwake();
+        }
+        else
+        {
+            // Gateway acknowledged sleep, nothing is expected until next awake
+            RestorePollPeriod();
+        }
+    }
+    else
+    {
+        // Client is disconnected or lost, there is nothing to awake
+        sIsAwake = false;
+        StopSleepCycle();
+        RestorePollPeriod();
+    }
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+
+    // Go to sleep and awake periodically to receive buffered messages
+    if (aCode != kCodeAccepted || StartSleepCycle(SLEEP_DURATION_MS) != OT_ERROR_NONE)
+    {
+        // Client stays active, stop fast polling
+        RestorePollPeriod();
+    }
+}
+
+static void HandleConnected(ReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Set callback for received messages
+        sClient->SetPublishReceivedCallback(HandlePublishReceived, NULL);
+        // Obtain target topic ID
+        Topic topic = Topic::FromTopicName(TOPIC_NAME);
+        sClient->Subscribe(topic, kQos1, HandleSubscribed, NULL);
+    }
+    else
+    {
+        // Connection was rejected or timed out, stop fast polling
+        RestorePollPeriod();
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Poll fast while connecting and subscribing
+    SetPollPeriod(POLL_PERIOD_FAST_MS);
+    // Register connected and disconnected callbacks
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli sleepCycleTimer(instance, HandleSleepCycleTimer, NULL);
+    sSleepCycleTimer = &sleepCycleTimer;
+    sInstance = &instance;
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,667 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define CONFIG_TOPIC_NAME "devices/thread/config"
+#define RESET_TOPIC_NAME "devices/thread/reset"
+#define ALERTS_TOPIC_NAME "alerts/#"
+#define SENSOR_COMMANDS_TOPIC_NAME "sensors/+/cmd"
+
+// Dispatch table size, must be power of two
+#define DISPATCH_TABLE_SIZE 16
+// Maximal number of subscriptions waiting for SUBACK
+#define SUBSCRIBE_PENDING_SIZE 4
+#define TOPIC_NAME_MAX_LENGTH 31
+// Maximal number of topic levels stored in wildcard filter trie
+#define FILTER_TRIE_SIZE 32
+#define FILTER_LEVEL_MAX_LENGTH 15
+
+using namespace ot::Mqttsn;
+
+// Handler bound to one topic ID, filter node is the subscription the entry was created for
+struct DispatchEntry
+{
+    bool mIsUsed;
+    TopicId mTopicId;
+    uint8_t mFilterNode;
+    otMqttsnPublishReceivedHandler mHandler;
+    void* mContext;
+};
+
+struct SubscribeRequest
+{
+    bool mIsUsed;
+    bool mIsWildcard;
+    char mTopicName[TOPIC_NAME_MAX_LENGTH + 1];
+    otMqttsnPublishReceivedHandler mHandler;
+    void* mContext;
+    otMqttsnSubscribedHandler mCallback;
+    void* mCallbackContext;
+};
+
+// One topic level of subscription filter. Children are kept as linked list
+// of node indexes, index 0 is the root and means no node. Node of subscribed
+// topic name without wildcards keeps topic ID assigned by SUBACK.
+struct FilterNode
+{
+    char mLevel[FILTER_LEVEL_MAX_LENGTH + 1];
+    uint8_t mFirstChild;
+    uint8_t mNextSibling;
+    bool mHasTopicId;
+    TopicId mTopicId;
+    otMqttsnPublishReceivedHandler mHandler;
+    void* mContext;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// Open addressing table keyed by topic ID, lookup is O(1) on average
+static DispatchEntry sDispatchTable[DISPATCH_TABLE_SIZE];
+static uint8_t sDispatchCount = 0;
+static SubscribeRequest sSubscribeRequests[SUBSCRIBE_PENDING_SIZE];
+// Active subscriptions, topic names registered by the gateway are matched
+// against wildcard filters once at REGISTER time and resulting topic ID is put
+// to dispatch table. Nodes are not freed on unsubscribe, they are reused when
+// the same filter is subscribed again and all of them are released on clean connect.
+static FilterNode sFilterTrie[FILTER_TRIE_SIZE];
+static uint8_t sFilterTrieCount = 1;
+// Handler for messages with topic ID which is not in the table
+static otMqttsnPublishReceivedHandler sFallbackHandler = NULL;
+static void* sFallbackContext = NULL;
+
+static DispatchEntry *DispatchFind(TopicId aTopicId, bool aForInsert)
+{
+    uint8_t index = aTopicId & (DISPATCH_TABLE_SIZE - 1);
+
+    // Linear probing from topic ID slot
+    for (uint8_t i = 0; i < DISPATCH_TABLE_SIZE; i++)
+    {
+        DispatchEntry &entry = sDispatchTable[(index + i) & (DISPATCH_TABLE_SIZE - 1)];
+        if (entry.mIsUsed && entry.mTopicId == aTopicId)
+        {
+            return &entry;
+        }
+        if (!entry.mIsUsed)
+        {
+            return aForInsert ? &entry : NULL;
+        }
+    }
+    return NULL;
+}
+
+static otError DispatchAdd(TopicId aTopicId, uint8_t aFilterNode, otMqttsnPublishReceivedHandler aHandler,
+    void* aContext)
+{
+    DispatchEntry *entry;
+
+    // Keep one slot free so unsuccessful lookup always terminates early
+    if (DispatchFind(aTopicId, false) == NULL && sDispatchCount >= DISPATCH_TABLE_SIZE - 1)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    entry = DispatchFind(aTopicId, true);
+    if (!entry->mIsUsed)
+    {
+        entry->mIsUsed = true;
+        entry->mTopicId = aTopicId;
+        sDispatchCount++;
+    }
+    entry->mFilterNode = aFilterNode;
+    entry->mHandler = aHandler;
+    entry->mContext = aContext;
+    return OT_ERROR_NONE;
+}
+
+static void DispatchRemove(TopicId aTopicId)
+{
+    DispatchEntry *entry = DispatchFind(aTopicId, false);
+    uint8_t hole;
+    uint8_t index;
+
+    if (entry == NULL)
+    {
+        return;
+    }
+    entry->mIsUsed = false;
+    sDispatchCount--;
+    // Move following entries of the probe sequence back to the hole so lookup
+    // does not stop at it, entry moves only when the hole is on its probe path
+    hole = static_cast<uint8_t>(entry - sDispatchTable);
+    index = hole;
+    while (true)
+    {
+        index = (index + 1) & (DISPATCH_TABLE_SIZE - 1);
+        DispatchEntry &next = sDispatchTable[index];
+        if (!next.mIsUsed)
+        {
+            break;
+        }
+        uint8_t home = next.mTopicId & (DISPATCH_TABLE_SIZE - 1);
+        if (((index - home) & (DISPATCH_TABLE_SIZE - 1)) >= ((index - hole) & (DISPATCH_TABLE_SIZE - 1)))
+        {
+            sDispatchTable[hole] = next;
+            next.mIsUsed = false;
+            hole = index;
+        }
+    }
+}
+
+// Remove all topic IDs dispatched to subscription of given filter node
+static void DispatchRemoveFilter(uint8_t aFilterNode)
+{
+    bool removed = true;
+
+    // Removal moves entries, scan again after each one
+    while (removed)
+    {
+        removed = false;
+        for (uint8_t i = 0; i < DISPATCH_TABLE_SIZE; i++)
+        {
+            if (sDispatchTable[i].mIsUsed && sDispatchTable[i].mFilterNode == aFilterNode)
+            {
+                DispatchRemove(sDispatchTable[i].mTopicId);
+                removed = true;
+                break;
+            }
+        }
+    }
+}
+
+// Return length of topic level starting at aName
+static uint8_t GetLevelLength(const char* aName)
+{
+    const char* end = strchr(aName, '/');
+    return static_cast<uint8_t>(end != NULL ? end - aName : strlen(aName));
+}
+
+// Return index of child node with given level or 0 when there is none
+static uint8_t FilterTrieFindChild(uint8_t aNode, const char* aLevel, uint8_t aLength)
+{
+    uint8_t child = sFilterTrie[aNode].mFirstChild;
+
+    while (child != 0 && (strncmp(sFilterTrie[child].mLevel, aLevel, aLength) != 0
+        || sFilterTrie[child].mLevel[aLength] != '\0'))
+    {
+        child = sFilterTrie[child].mNextSibling;
+    }
+    return child;
+}
+
+// Return node of exactly given filter or 0 when it is not in the trie
+static uint8_t FilterTrieFind(const char* aFilter)
+{
+    uint8_t node = 0;
+
+    while (true)
+    {
+        uint8_t length = GetLevelLength(aFilter);
+
+        node = FilterTrieFindChild(node, aFilter, length);
+        if (node == 0 || aFilter[length] == '\0')
+        {
+            return node;
+        }
+        aFilter += length + 1;
+    }
+}
+
+static otError FilterTrieAdd(const char* aFilter, otMqttsnPublishReceivedHandler aHandler, void* aContext,
+    uint8_t &aNode)
+{
+    uint8_t node = 0;
+
+    while (true)
+    {
+        uint8_t length = GetLevelLength(aFilter);
+        uint8_t child;
+
+        if (length > FILTER_LEVEL_MAX_LENGTH)
+        {
+            return OT_ERROR_INVALID_ARGS;
+        }
+        child = FilterTrieFindChild(node, aFilter, length);
+        if (child == 0)
+        {
+            if (sFilterTrieCount == FILTER_TRIE_SIZE)
+            {
+                return OT_ERROR_NO_BUFS;
+            }
+            child = sFilterTrieCount++;
+            memcpy(sFilterTrie[child].mLevel, aFilter, length);
+            sFilterTrie[child].mLevel[length] = '\0';
+            sFilterTrie[child].mNextSibling = sFilterTrie[node].mFirstChild;
+            sFilterTrie[node].mFirstChild = child;
+        }
+        node = child;
+        if (aFilter[length] == '\0')
+        {
+            break;
+        }
+        aFilter += length + 1;
+    }
+    sFilterTrie[node].mHandler = aHandler;
+    sFilterTrie[node].mContext = aContext;
+    sFilterTrie[node].mHasTopicId = false;
+    aNode = node;
+    return OT_ERROR_NONE;
+}
+
+// Forget all topic IDs and subscriptions, they are not valid in clean session
+static void DispatchReset()
+{
+    memset(sDispatchTable, 0, sizeof(sDispatchTable));
+    sDispatchCount = 0;
+    memset(sFilterTrie, 0, sizeof(sFilterTrie));
+    sFilterTrieCount = 1;
+    for (uint8_t i = 0; i < SUBSCRIBE_PENDING_SIZE; i++)
+    {
+        sSubscribeRequests[i].mIsUsed = false;
+    }
+}
+
+// Find filter node matching topic name from aNode, exact level match takes
+// precedence over '+' and '#' wildcards
+static const FilterNode *FilterTrieMatch(uint8_t aNode, const char* aName)
+{
+    uint8_t length = GetLevelLength(aName);
+    const FilterNode *exact = NULL;
+    const FilterNode *single = NULL;
+    const FilterNode *multi = NULL;
+
+    for (uint8_t child = sFilterTrie[aNode].mFirstChild; child != 0; child = sFilterTrie[child].mNextSibling)
+    {
+        const char* level = sFilterTrie[child].mLevel;
+        const FilterNode *match = NULL;
+
+        if (strcmp(level, "#") == 0)
+        {
+            multi = sFilterTrie[child].mHandler != NULL ? &sFilterTrie[child] : NULL;
+            continue;
+        }
+        if (strcmp(level, "+") != 0 && (strncmp(level, aName, length) != 0 || level[length] != '\0'))
+        {
+            continue;
+        }
+        if (aName[length] == '\0')
+        {
+            // Filter "a/#" matches also topic "a"
+            uint8_t hashChild = sFilterTrie[child].mHandler != NULL ? 0 : FilterTrieFindChild(child, "#", 1);
+            match = sFilterTrie[child].mHandler != NULL ? &sFilterTrie[child]
+                : (hashChild != 0 && sFilterTrie[hashChild].mHandler != NULL ? &sFilterTrie[hashChild] : NULL);
+        }
+        else
+        {
+            match = FilterTrieMatch(child, aName + length + 1);
+        }
+        if (level[0] == '+')
+        {
+            single = match;
+        }
+        else
+        {
+            exact = match;
+        }
+    }
+    return exact != NULL ? exact : (single != NULL ? single : multi);
+}
+
+static void SetFallbackHandler(otMqttsnPublishReceivedHandler aHandler, void* aContext)
+{
+    sFallbackHandler = aHandler;
+    sFallbackContext = aContext;
+}
+
+static otMqttsnReturnCode HandleDispatchPublishReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    const DispatchEntry *entry = DispatchFind(static_cast<const Topic *>(aTopic)->GetTopicId(), false);
+
+    if (entry != NULL)
+    {
+        return entry->mHandler(aPayload, aPayloadLength, aTopic, entry->mContext);
+    }
+    if (sFallbackHandler != NULL)
+    {
+        return sFallbackHandler(aPayload, aPayloadLength, aTopic, sFallbackContext);
+    }
+    return kCodeRejectedTopicId;
+}
+
+static otMqttsnReturnCode HandleDispatchRegisterReceived(TopicId aTopicId, const char* aTopicName, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    const FilterNode *filter = FilterTrieMatch(0, aTopicName);
+
+    // Gateway registers concrete topics matching wildcard subscription before it sends PUBLISH
+    if (filter != NULL)
+    {
+        return DispatchAdd(aTopicId, static_cast<uint8_t>(filter - sFilterTrie), filter->mHandler,
+            filter->mContext) == OT_ERROR_NONE ? kCodeAccepted : kCodeRejectedCongestion;
+    }
+    return kCodeAccepted;
+}
+
+static void HandleDispatchSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    SubscribeRequest &request = *static_cast<SubscribeRequest *>(aContext);
+
+    if (!request.mIsUsed)
+    {
+        // Request was dropped by clean connect
+        return;
+    }
+    if (aCode == kCodeAccepted)
+    {
+        uint8_t node;
+        TopicId topicId = static_cast<const Topic *>(aTopic)->GetTopicId();
+
+        // Every subscription is kept in the trie so it can be found by name on unsubscribe
+        if (FilterTrieAdd(request.mTopicName, request.mHandler, request.mContext, node) != OT_ERROR_NONE)
+        {
+            aCode = kCodeRejectedCongestion;
+        }
+        else if (!request.mIsWildcard)
+        {
+            if (DispatchAdd(topicId, node, request.mHandler, request.mContext) == OT_ERROR_NONE)
+            {
+                sFilterTrie[node].mHasTopicId = true;
+                sFilterTrie[node].mTopicId = topicId;
+            }
+            else
+            {
+                sFilterTrie[node].mHandler = NULL;
+                aCode = kCodeRejectedCongestion;
+            }
+        }
+    }
+    request.mIsUsed = false;
+    if (request.mCallback != NULL)
+    {
+        request.mCallback(aCode, aTopic, aQos, request.mCallbackContext);
+    }
+}
+
+static otError SubscribeWithHandler(const char* aTopicName, Qos aQos, otMqttsnPublishReceivedHandler aHandler,
+    void* aContext, otMqttsnSubscribedHandler aCallback, void* aCallbackContext)
+{
+    SubscribeRequest *request = NULL;
+    otError error;
+
+    for (uint8_t i = 0; i < SUBSCRIBE_PENDING_SIZE; i++)
+    {
+        if (!sSubscribeRequests[i].mIsUsed)
+        {
+            request = &sSubscribeRequests[i];
+            break;
+        }
+    }
+    if (request == NULL || strlen(aTopicName) > TOPIC_NAME_MAX_LENGTH)
+    {
+        return OT_ERROR_NO_BUFS;
+    }
+    request->mIsUsed = true;
+    request->mIsWildcard = strchr(aTopicName, '+') != NULL || strchr(aTopicName, '#') != NULL;
+    strcpy(request->mTopicName, aTopicName);
+    request->mHandler = aHandler;
+    request->mContext = aContext;
+    request->mCallback = aCallback;
+    request->mCallbackContext = aCallbackContext;
+    error = sClient->Subscribe(Topic::FromTopicName(aTopicName), aQos, HandleDispatchSubscribed, request);
+    if (error != OT_ERROR_NONE)
+    {
+        request->mIsUsed = false;
+    }
+    return error;
+}
+
+// Stop dispatching messages of the subscription right away and send UNSUBSCRIBE
+static otError UnsubscribeWithHandler(const char* aTopicName, otMqttsnUnsubscribedHandler aCallback,
+    void* aCallbackContext)
+{
+    uint8_t node = FilterTrieFind(aTopicName);
+
+    if (node != 0)
+    {
+        DispatchRemoveFilter(node);
+        sFilterTrie[node].mHandler = NULL;
+        sFilterTrie[node].mHasTopicId = false;
+    }
+    return sClient->Unsubscribe(Topic::FromTopicName(aTopicName), aCallback, aCallbackContext);
+}
+
+static void HandleUnsubscribed(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle unsubscribed event
+}
+
+static otMqttsnReturnCode HandleConfigReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received configuration
+
+    // Alerts may be switched off by configuration
+    if (aPayloadLength == 10 && memcmp(aPayload, "alerts:off", 10) == 0)
+    {
+        UnsubscribeWithHandler(ALERTS_TOPIC_NAME, HandleUnsubscribed, NULL);
+    }
+    return kCodeAccepted;
+}
+
+static otMqttsnReturnCode HandleResetReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received reset command
+
+    return kCodeAccepted;
+}
+
+static otMqttsnReturnCode HandleAlertReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle received message from any alerts topic
+
+    return kCodeAccepted;
+}
+
+static otMqttsnReturnCode HandleSensorCommandReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle command for any of the sensors
+
+    return kCodeAccepted;
+}
+
+static otMqttsnReturnCode HandleUnknownReceived(const uint8_t* aPayload, int32_t aPayloadLength, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aPayload);
+    OT_UNUSED_VARIABLE(aPayloadLength);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle message from topic without bound handler
+
+    return kCodeAccepted;
+}
+
+static void HandleSubscribed(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, otMqttsnQos aQos, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aCode);
+    OT_UNUSED_VARIABLE(aTopic);
+    OT_UNUSED_VARIABLE(aQos);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle subscribed event
+}
+
+static void HandleConnected(ReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Clean session starts without subscriptions, topic IDs of the previous one are not valid
+        DispatchReset();
+        // Set callbacks dispatching received messages and gateway registrations
+        sClient->SetPublishReceivedCallback(HandleDispatchPublishReceived, NULL);
+        sClient->SetRegisterReceivedCallback(HandleDispatchRegisterReceived, NULL);
+        SetFallbackHandler(HandleUnknownReceived, NULL);
+        // Subscribe topics each with its own handler
+        SubscribeWithHandler(CONFIG_TOPIC_NAME, kQos1, HandleConfigReceived, NULL, HandleSubscribed, NULL);
+        SubscribeWithHandler(RESET_TOPIC_NAME, kQos1, HandleResetReceived, NULL, HandleSubscribed, NULL);
+        SubscribeWithHandler(ALERTS_TOPIC_NAME, kQos1, HandleAlertReceived, NULL, HandleSubscribed, NULL);
+        SubscribeWithHandler(SENSOR_COMMANDS_TOPIC_NAME, kQos1, HandleSensorCommandReceived, NULL,
+            HandleSubscribed, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected callback
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}
@@ -0,0 +1,485 @@
+/*
+ *  Copyright (c) 2018, Vit Holasek
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/instance.hpp"
+#include "common/timer.hpp"
+#include "openthread/instance.h"
+#include "openthread-system.h"
+#include "utils/slaac_address.hpp"
+
+#include "mqttsn/mqttsn_client.hpp"
+
+#define NETWORK_NAME "OTBR4444"
+#define PANID 0x4444
+#define EXTPANID {0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x44, 0x44}
+#define DEFAULT_CHANNEL 15
+#define MASTER_KEY {0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44, 0x33, 0x33, 0x44, 0x44}
+
+#define GATEWAY_PORT 10000
+#define GATEWAY_ADDRESS "2018:ff9b::ac12:8"
+
+#define CLIENT_ID "THREAD"
+#define CLIENT_PORT 10000
+
+#define TOPIC_NAME "sensors"
+
+// Timer wheel resolution and number of slots, slot count must match width of occupancy bitmap
+#define WHEEL_TICK_MS 100
+#define WHEEL_SLOT_COUNT 64
+// Period of measurement publishing
+#define PUBLISH_INTERVAL_MS 5000
+// Time after which unacknowledged message is reported as lost
+#define PUBLISH_DEADLINE_MS 30000
+// Maximal number of QoS 1 messages waiting for PUBACK at the same time
+#define PUBLISH_WINDOW_SIZE 4
+
+using namespace ot::Mqttsn;
+
+struct WheelTimer;
+
+typedef void (*WheelHandler)(WheelTimer &aTimer, void* aContext);
+
+// Timer entry linked into one of the wheel slots. Entry is owned by the user
+// and arming or cancelling it only relinks pointers, so both are O(1).
+struct WheelTimer
+{
+    WheelTimer* mNext;
+    WheelTimer* mPrev;
+    uint32_t mFireTick;
+    WheelHandler mHandler;
+    void* mContext;
+};
+
+// Slot of in-flight window with deadline for PUBACK. Slot stays used after
+// its deadline expires until client reports the publish result, because the
+// slot pointer is still held by the client as callback context.
+struct InFlightMessage
+{
+    bool mIsUsed;
+    bool mIsExpired;
+    WheelTimer mDeadline;
+};
+
+static MqttsnClient* sClient = NULL;
+
+static const uint8_t sExpanId[] = EXTPANID;
+static const uint8_t sMasterKey[] = MASTER_KEY;
+
+// All application deadlines share single OpenThread timer which is always
+// armed to the earliest deadline, so there is one wakeup per deadline
+static ot::TimerMilli* sWheelTimer = NULL;
+// Slot heads of circular doubly linked lists. Fire tick of the head holds
+// the earliest fire tick in the slot, it may be lower after entry is removed.
+static WheelTimer sWheelSlots[WHEEL_SLOT_COUNT];
+// Bit set for every slot which is not empty
+static uint64_t sWheelOccupied = 0;
+// Tick clock advanced by whole ticks, time of the current tick start keeps the remainder
+static uint32_t sWheelClockTick = 0;
+static uint32_t sWheelClockTime = 0;
+// Last processed tick and tick to which OpenThread timer is armed
+static uint32_t sWheelTick = 0;
+static uint32_t sWheelArmedTick = 0;
+static uint16_t sWheelCount = 0;
+
+static WheelTimer sPublishTimer;
+static InFlightMessage sWindow[PUBLISH_WINDOW_SIZE];
+static otMqttsnTopic sTopic;
+static uint16_t sLostCount = 0;
+
+// Advance tick clock by ticks elapsed since its last update. Tick counter runs
+// through all 32-bit values independently of millisecond time, so modular tick
+// comparison stays valid when millisecond time wraps.
+static uint32_t WheelGetNowTick()
+{
+    uint32_t ticks = (ot::TimerMilli::GetNow().GetValue() - sWheelClockTime) / WHEEL_TICK_MS;
+
+    sWheelClockTick += ticks;
+    sWheelClockTime += ticks * WHEEL_TICK_MS;
+    return sWheelClockTick;
+}
+
+static bool WheelIsBefore(uint32_t aTick, uint32_t aOtherTick)
+{
+    // Ticks are compared by signed difference, deadlines must be less than 2^31 ticks apart
+    return static_cast<int32_t>(aTick - aOtherTick) < 0;
+}
+
+static void WheelInit(ot::TimerMilli &aTimer)
+{
+    sWheelTimer = &aTimer;
+    sWheelClockTime = ot::TimerMilli::GetNow().GetValue();
+    sWheelClockTick = 0;
+    sWheelTick = 0;
+    for (uint16_t i = 0; i < WHEEL_SLOT_COUNT; i++)
+    {
+        sWheelSlots[i].mNext = &sWheelSlots[i];
+        sWheelSlots[i].mPrev = &sWheelSlots[i];
+    }
+}
+
+static bool WheelTimerIsRunning(const WheelTimer &aTimer)
+{
+    return aTimer.mNext != NULL;
+}
+
+static void WheelArm(uint32_t aFireTick)
+{
+    uint32_t nowTick = WheelGetNowTick();
+    // Fire time is derived from the tick clock, both differences are small
+    uint32_t fireTime = sWheelClockTime + (aFireTick - nowTick) * WHEEL_TICK_MS;
+    int32_t delay = static_cast<int32_t>(fireTime - ot::TimerMilli::GetNow().GetValue());
+
+    sWheelArmedTick = aFireTick;
+    sWheelTimer->Start(delay > 0 ? static_cast<uint32_t>(delay) : 0);
+}
+
+// Arm OpenThread timer to the earliest deadline in the wheel
+static void WheelSchedule()
+{
+    uint32_t first = (sWheelTick + 1) & (WHEEL_SLOT_COUNT - 1);
+    uint64_t pending;
+    bool hasEarliest = false;
+    uint32_t nextTick = 0;
+
+    if (sWheelCount == 0)
+    {
+        sWheelTimer->Stop();
+        return;
+    }
+    // Visit only occupied slots in wheel order using the rotated bitmap, entries are not walked
+    pending = first == 0 ? sWheelOccupied
+        : (sWheelOccupied >> first) | (sWheelOccupied << (WHEEL_SLOT_COUNT - first));
+    while (pending != 0)
+    {
+        uint32_t tick = sWheelTick + 1 + __builtin_ctzll(pending);
+        uint32_t fireTick = sWheelSlots[tick & (WHEEL_SLOT_COUNT - 1)].mFireTick;
+        pending &= pending - 1;
+        // First slot with deadline in current revolution is the earliest one
+        if (!WheelIsBefore(tick, fireTick))
+        {
+            nextTick = tick;
+            hasEarliest = true;
+            break;
+        }
+        // Otherwise all deadlines are further than one revolution, find the earliest one
+        if (!hasEarliest || WheelIsBefore(fireTick, nextTick))
+        {
+            nextTick = fireTick;
+            hasEarliest = true;
+        }
+    }
+    WheelArm(nextTick);
+}
+
+static void WheelTimerStop(WheelTimer &aTimer)
+{
+    if (!WheelTimerIsRunning(aTimer))
+    {
+        return;
+    }
+    aTimer.mPrev->mNext = aTimer.mNext;
+    aTimer.mNext->mPrev = aTimer.mPrev;
+    aTimer.mNext = NULL;
+    aTimer.mPrev = NULL;
+    sWheelCount--;
+
+    uint32_t slot = aTimer.mFireTick & (WHEEL_SLOT_COUNT - 1);
+    if (sWheelSlots[slot].mNext == &sWheelSlots[slot])
+    {
+        sWheelOccupied &= ~(static_cast<uint64_t>(1) << slot);
+    }
+}
+
+static void WheelTimerStart(WheelTimer &aTimer, uint32_t aDelay, WheelHandler aHandler, void* aContext)
+{
+    uint32_t ticks = (aDelay + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    uint32_t nowTick;
+    bool isEarliest;
+
+    WheelTimerStop(aTimer);
+    if (sWheelCount == 0)
+    {
+        // Nothing is pending, restart tick clock so idle time longer than
+        // millisecond timer range cannot corrupt it
+        sWheelClockTime = ot::TimerMilli::GetNow().GetValue();
+        sWheelTick = sWheelClockTick;
+    }
+    nowTick = WheelGetNowTick();
+    aTimer.mFireTick = (WheelIsBefore(sWheelTick, nowTick) ? nowTick : sWheelTick) + (ticks > 0 ? ticks : 1);
+    aTimer.mHandler = aHandler;
+    aTimer.mContext = aContext;
+    uint32_t slot = aTimer.mFireTick & (WHEEL_SLOT_COUNT - 1);
+    WheelTimer &head = sWheelSlots[slot];
+    if (head.mNext == &head || WheelIsBefore(aTimer.mFireTick, head.mFireTick))
+    {
+        head.mFireTick = aTimer.mFireTick;
+    }
+    sWheelOccupied |= static_cast<uint64_t>(1) << slot;
+    aTimer.mNext = &head;
+    aTimer.mPrev = head.mPrev;
+    head.mPrev->mNext = &aTimer;
+    head.mPrev = &aTimer;
+    sWheelCount++;
+
+    // Re-arm OpenThread timer only when new deadline is the earliest one
+    isEarliest = !sWheelTimer->IsRunning() || WheelIsBefore(aTimer.mFireTick, sWheelArmedTick);
+    if (isEarliest)
+    {
+        WheelArm(aTimer.mFireTick);
+    }
+}
+
+static void HandleWheelTimer(ot::Timer &aTimer)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    uint32_t nowTick = WheelGetNowTick();
+    uint32_t elapsed = nowTick - sWheelTick;
+
+    // Process all slots passed since last wakeup, at most one revolution
+    if (elapsed > WHEEL_SLOT_COUNT)
+    {
+        elapsed = WHEEL_SLOT_COUNT;
+    }
+    for (uint32_t i = 1; i <= elapsed; i++)
+    {
+        WheelTimer &head = sWheelSlots[(nowTick - elapsed + i) & (WHEEL_SLOT_COUNT - 1)];
+        WheelTimer* timer = head.mNext;
+        while (timer != &head)
+        {
+            WheelTimer* next = timer->mNext;
+            // Entries for later revolutions stay in the slot
+            if (!WheelIsBefore(nowTick, timer->mFireTick))
+            {
+                WheelTimerStop(*timer);
+                timer->mHandler(*timer, timer->mContext);
+                // Handler may have restarted timers, continue from slot head
+                next = head.mNext;
+            }
+            timer = next;
+        }
+        // Remaining entries belong to later revolutions, refresh earliest fire tick of the slot
+        for (timer = head.mNext; timer != &head; timer = timer->mNext)
+        {
+            if (timer == head.mNext || WheelIsBefore(timer->mFireTick, head.mFireTick))
+            {
+                head.mFireTick = timer->mFireTick;
+            }
+        }
+    }
+    sWheelTick = nowTick;
+    WheelSchedule();
+}
+
+static void HandlePublished(otMqttsnReturnCode aCode, void* aContext)
+{
+    InFlightMessage &slot = *static_cast<InFlightMessage *>(aContext);
+    // Handle published
+
+    if (!slot.mIsUsed)
+    {
+        return;
+    }
+    // Message with expired deadline was already counted as lost
+    if (aCode != kCodeAccepted && !slot.mIsExpired)
+    {
+        sLostCount++;
+    }
+    // Client no longer references the slot, it may be reused
+    WheelTimerStop(slot.mDeadline);
+    slot.mIsUsed = false;
+}
+
+static void HandlePublishDeadline(WheelTimer &aTimer, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aTimer);
+    InFlightMessage &slot = *static_cast<InFlightMessage *>(aContext);
+
+    // Message was not acknowledged in time, report it as lost. Slot is released
+    // when client finishes the publish and calls HandlePublished.
+    sLostCount++;
+    slot.mIsExpired = true;
+}
+
+static void HandlePublishTimer(WheelTimer &aTimer, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    const char* data = "{\"temperature\":24.0}";
+    int32_t length = strlen(data);
+
+    // Schedule next measurement first so the period does not drift with processing
+    WheelTimerStart(aTimer, PUBLISH_INTERVAL_MS, HandlePublishTimer, NULL);
+    for (uint8_t i = 0; i < PUBLISH_WINDOW_SIZE; i++)
+    {
+        InFlightMessage &slot = sWindow[i];
+        if (slot.mIsUsed)
+        {
+            continue;
+        }
+        if (sClient->Publish(reinterpret_cast<const uint8_t *>(data), length, kQos1, false,
+            *static_cast<const Topic *>(&sTopic), HandlePublished, &slot) == OT_ERROR_NONE)
+        {
+            slot.mIsUsed = true;
+            slot.mIsExpired = false;
+            WheelTimerStart(slot.mDeadline, PUBLISH_DEADLINE_MS, HandlePublishDeadline, &slot);
+        }
+        break;
+    }
+}
+
+static void HandleRegistered(otMqttsnReturnCode aCode, const otMqttsnTopic* aTopic, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle registered
+
+    if (aCode == kCodeAccepted)
+    {
+        // Start periodic publishing to the registered topic
+        sTopic = *aTopic;
+        WheelTimerStart(sPublishTimer, 0, HandlePublishTimer, NULL);
+    }
+}
+
+static void HandleDisconnected(otMqttsnDisconnectType aType, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aType);
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle disconnect
+
+    WheelTimerStop(sPublishTimer);
+}
+
+static void HandleConnected(otMqttsnReturnCode aCode, void* aContext)
+{
+    OT_UNUSED_VARIABLE(aContext);
+    // Handle connected
+
+    if (aCode == kCodeAccepted)
+    {
+        // Obtain target topic ID
+        sClient->Register(TOPIC_NAME, HandleRegistered, NULL);
+    }
+}
+
+static void MqttsnConnect()
+{
+    ot::Ip6::Address address;
+    address.FromString(GATEWAY_ADDRESS);
+    MqttsnConfig config;
+
+    // Set MQTT-SN client configuration settings
+    config.SetClientId(CLIENT_ID);
+    config.SetKeepAlive(30);
+    config.SetCleanSession(true);
+    config.SetPort(GATEWAY_PORT);
+    config.SetAddress(address);
+
+    // Register connected and disconnected callbacks
+    sClient->SetConnectedCallback(HandleConnected, NULL);
+    sClient->SetDisconnectedCallback(HandleDisconnected, NULL);
+    // Connect to the MQTT broker (gateway)
+    sClient->Connect(config);
+}
+
+static void StateChanged(otChangedFlags aFlags, void *aContext)
+{
+    ot::Instance &instance = *reinterpret_cast<ot::Instance*>(aContext);
+    // when thread role changed
+    if (aFlags & OT_CHANGED_THREAD_ROLE)
+    {
+        otDeviceRole role = instance.Get<ot::Mle::MleRouter>().GetRole();
+        // If role changed to any of active roles and MQTT-SN client is not connected then connect
+        if ((role == OT_DEVICE_ROLE_CHILD || role == OT_DEVICE_ROLE_LEADER || role == OT_DEVICE_ROLE_ROUTER)
+            && sClient->GetState() == kStateDisconnected)
+        {
+            MqttsnConnect();
+        }
+    }
+}
+
+int main(int aArgc, char *aArgv[])
+{
+    otError error = OT_ERROR_NONE;
+    ot::Mac::ExtendedPanId extendedPanid;
+    ot::MasterKey masterKey;
+
+    otSysInit(aArgc, aArgv);
+    ot::Instance &instance = ot::Instance::InitSingle();
+    sClient = &instance.Get<MqttsnClient>();
+    ot::ThreadNetif &netif = instance.Get<ot::ThreadNetif>();
+    ot::Mac::Mac &mac = instance.Get<ot::Mac::Mac>();
+    ot::TimerMilli wheelTimer(instance, HandleWheelTimer, NULL);
+
+    WheelInit(wheelTimer);
+
+    // Set default network settings
+    // Set network name
+    SuccessOrExit(error = mac.SetNetworkName(NETWORK_NAME));
+    // Set extended PANID
+    memcpy(extendedPanid.m8, sExpanId, sizeof(sExpanId));
+    mac.SetExtendedPanId(extendedPanid);
+    // Set PANID
+    mac.SetPanId(PANID);
+    // Set channel
+    SuccessOrExit(error = mac.SetPanChannel(DEFAULT_CHANNEL));
+    // Set masterkey
+    memcpy(masterKey.m8, sMasterKey, sizeof(sMasterKey));
+    SuccessOrExit(error = instance.Get<ot::KeyManager>().SetMasterKey(masterKey));
+
+    instance.Get<ot::MeshCoP::ActiveDataset>().Clear();
+    instance.Get<ot::MeshCoP::PendingDataset>().Clear();
+    // Register notifier callback to receive thread role changed events
+    instance.Get<ot::Notifier>().RegisterCallback(StateChanged, &instance);
+
+    // Start thread network
+    instance.Get<ot::Utils::Slaac>().Enable();
+    netif.Up();
+    SuccessOrExit(error = instance.Get<ot::Mle::MleRouter>().Start(false));
+
+    // Start MQTT-SN client
+    SuccessOrExit(error = sClient->Start(CLIENT_PORT));
+
+    while (true)
+    {
+        instance.Get<ot::TaskletScheduler>().ProcessQueuedTasklets();
+        otSysProcessDrivers(&instance);
+    }
+    return 0;
+
+exit:
+    return 1;
+}
+
+extern "C" void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
+{
+    OT_UNUSED_VARIABLE(aLogLevel);
+    OT_UNUSED_VARIABLE(aLogRegion);
+    OT_UNUSED_VARIABLE(aFormat);
+}